@@ -0,0 +1,124 @@
+#include <mymuduo/net/TcpServer.hh>
+#include <mymuduo/base/Timestamp.hh>
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <thread>
+#include <vector>
+#include <mutex>
+#include <cstdio>
+
+/*
+    subloop绑定CPU的延迟测试
+    同样的echo服务器分别在不绑定和setAutoCpuAffinity两种模式下运行
+    每个客户端线程一个连接 不停地发送64字节的请求并等待回复 统计往返延迟的p50 p99 p999
+    用法: bench_affinity [subloop数量] [客户端数量] [每种模式运行的秒数]
+*/
+
+struct Result {
+    size_t count;
+    int64_t p50;
+    int64_t p99;
+    int64_t p999;
+};
+
+static int connectTo(uint16_t port) {
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr;
+    bzero(&addr, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    if (::connect(fd, (sockaddr*)&addr, sizeof(addr)) < 0) {
+        perror("connect");
+        exit(1);
+    }
+    int one = 1;
+    ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return fd;
+}
+
+/* 一个客户端连接 在seconds秒内不停地请求-应答 记录每次的往返时间(微秒) */
+static void pingPong(uint16_t port, double seconds, std::vector<int64_t>* latencies) {
+    int fd = connectTo(port);
+    char buf[64] = {0};
+    Timestamp end(addTime(Timestamp::monotonicNow(), seconds));
+    while (Timestamp::monotonicNow() < end) {
+        Timestamp start(Timestamp::monotonicNow());
+        if (::write(fd, buf, sizeof(buf)) != sizeof(buf)) {
+            break;
+        }
+        size_t got = 0;
+        while (got < sizeof(buf)) {
+            ssize_t n = ::read(fd, buf + got, sizeof(buf) - got);
+            if (n <= 0) {
+                break;
+            }
+            got += n;
+        }
+        latencies->push_back(Timestamp::monotonicNow().microSecondsSinceEpoch() - start.microSecondsSinceEpoch());
+    }
+    ::close(fd);
+}
+
+static Result run(bool pinned, uint16_t port, int numThreads, int numClients, double seconds) {
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(port), pinned ? "pinned" : "unpinned");
+    server.setThreadNum(numThreads);
+    server.setAutoCpuAffinity(pinned);
+    server.setConnectionCallback([](const TcpConnectionPtr&) {});
+    server.setMessageCallback([](const TcpConnectionPtr& conn, Buffer* buf, Timestamp) {
+        conn->send(buf->retrieveAllAsString());
+    });
+    server.start();
+
+    std::vector<int64_t> all;
+    std::thread clients([&]() {
+        std::vector<std::vector<int64_t>> latencies(numClients);
+        std::vector<std::thread> threads;
+        for (int i = 0; i < numClients; ++ i) {
+            threads.emplace_back(pingPong, port, seconds, &latencies[i]);
+        }
+        for (std::thread& t : threads) {
+            t.join();
+        }
+        for (auto& l : latencies) {
+            all.insert(all.end(), l.begin(), l.end());
+        }
+        loop.quit();
+    });
+    loop.loop();
+    clients.join();
+
+    Result result = {all.size(), 0, 0, 0};
+    if (!all.empty()) {
+        std::sort(all.begin(), all.end());
+        result.p50 = all[all.size() * 50 / 100];
+        result.p99 = all[all.size() * 99 / 100];
+        result.p999 = all[all.size() * 999 / 1000];
+    }
+    return result;
+}
+
+int main(int argc, char* argv[]) {
+    int numThreads = argc > 1 ? atoi(argv[1]) : 4;
+    int numClients = argc > 2 ? atoi(argv[2]) : 16;
+    double seconds = argc > 3 ? atof(argv[3]) : 5.0;
+
+    Result unpinned = run(false, 9981, numThreads, numClients, seconds);
+    Result pinned = run(true, 9982, numThreads, numClients, seconds);
+
+    printf("%10s %12s %10s %10s %10s\n", "mode", "requests", "p50(us)", "p99(us)", "p999(us)");
+    printf("%10s %12zu %10jd %10jd %10jd\n", "unpinned", unpinned.count, 
+           (intmax_t)unpinned.p50, (intmax_t)unpinned.p99, (intmax_t)unpinned.p999);
+    printf("%10s %12zu %10jd %10jd %10jd\n", "pinned", pinned.count, 
+           (intmax_t)pinned.p50, (intmax_t)pinned.p99, (intmax_t)pinned.p999);
+    printf("p99 difference (unpinned - pinned): %jd us\n", (intmax_t)(unpinned.p99 - pinned.p99));
+    return 0;
+}
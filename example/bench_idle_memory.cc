@@ -0,0 +1,135 @@
+#include <mymuduo/net/TcpServer.hh>
+#include <mymuduo/base/Logger.hh>
+
+#include <sys/socket.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <malloc.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <cstdio>
+
+/*
+    每个空闲连接占用的用户态内存
+    N个客户端连接各自发送一个请求并收到回复(长轮询/推送类连接的典型状态) 然后保持空闲
+    分别统计 连接刚处理完请求时 和 定期释放空闲缓冲区之后 堆内存和RSS的增量除以N
+    释放的内存留在malloc中供之后的连接复用 RSS保持在峰值 堆内存统计的是仍在使用的内存
+    客户端socket在同一个进程中 但只占用fd 不占用用户态内存
+    用法: bench_idle_memory [连接数] [subloop数量]
+*/
+
+static size_t heapBytes() {
+    struct mallinfo2 mi = mallinfo2();
+    return mi.uordblks + mi.hblkhd;
+}
+
+static size_t rssBytes() {
+    long pages = 0;
+    long resident = 0;
+    FILE* fp = fopen("/proc/self/statm", "r");
+    if (fp != nullptr) {
+        if (fscanf(fp, "%ld %ld", &pages, &resident) != 2) {
+            resident = 0;
+        }
+        fclose(fp);
+    }
+    return static_cast<size_t>(resident) * sysconf(_SC_PAGESIZE);
+}
+
+static int connectTo(uint16_t port) {
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr;
+    bzero(&addr, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    if (::connect(fd, (sockaddr*)&addr, sizeof(addr)) < 0) {
+        perror("connect");
+        exit(1);
+    }
+    return fd;
+}
+
+int main(int argc, char* argv[]) {
+    int numConns = argc > 1 ? atoi(argv[1]) : 5000;
+    int numThreads = argc > 2 ? atoi(argv[2]) : 2;
+
+    /* 服务端和客户端各需要numConns个fd */
+    struct rlimit rl;
+    getrlimit(RLIMIT_NOFILE, &rl);
+    rl.rlim_cur = rl.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &rl);
+    if (static_cast<rlim_t>(numConns) * 2 + 64 > rl.rlim_cur) {
+        numConns = static_cast<int>((rl.rlim_cur - 64) / 2);
+    }
+    /* 日志不计入统计 */
+    Logger::setOutput([](const char*, size_t) {});
+
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(9983), "idle");
+    server.setThreadNum(numThreads);
+    server.setBufferReleaseInterval(1.0);
+    std::atomic_int established(0);
+    server.setConnectionCallback([&](const TcpConnectionPtr& conn) {
+        if (conn->connected()) {
+            ++ established;
+        }
+    });
+    server.setMessageCallback([](const TcpConnectionPtr& conn, Buffer* buf, Timestamp) {
+        buf->retrieveAll();
+        conn->send("ok\n", 3);
+    });
+    server.start();
+
+    std::thread client([&]() {
+        std::vector<int> fds;
+        fds.reserve(numConns);
+        /* 等所有subloop启动完成 */
+        usleep(200 * 1000);
+        malloc_trim(0);
+        size_t heap0 = heapBytes();
+        size_t rss0 = rssBytes();
+
+        char request[100];
+        memset(request, 'r', sizeof(request));
+        char reply[16];
+        for (int i = 0; i < numConns; ++ i) {
+            int fd = connectTo(9983);
+            if (::write(fd, request, sizeof(request)) != sizeof(request) || ::read(fd, reply, sizeof(reply)) <= 0) {
+                perror("request");
+                exit(1);
+            }
+            fds.push_back(fd);
+        }
+        while (established < numConns) {
+            usleep(1000);
+        }
+        size_t heap1 = heapBytes();
+        size_t rss1 = rssBytes();
+
+        /* 等待定期释放空闲缓冲区 */
+        sleep(2);
+        size_t heap2 = heapBytes();
+        size_t rss2 = rssBytes();
+
+        printf("connections: %d  subloops: %d\n", numConns, numThreads);
+        printf("%-28s %14s %14s\n", "", "heap/conn(B)", "rss/conn(B)");
+        printf("%-28s %14.1f %14.1f\n", "after request", 
+               static_cast<double>(heap1 - heap0) / numConns, static_cast<double>(rss1 - rss0) / numConns);
+        printf("%-28s %14.1f %14.1f\n", "after idle buffer release", 
+               static_cast<double>(heap2 - heap0) / numConns, static_cast<double>(rss2 - rss0) / numConns);
+
+        for (int fd : fds) {
+            ::close(fd);
+        }
+        loop.runAfter(0.5, [&loop]() { loop.quit(); });
+    });
+    loop.loop();
+    client.join();
+    return 0;
+}
@@ -0,0 +1,105 @@
+#include <mymuduo/base/MpscQueue.hh>
+#include <mymuduo/base/Timestamp.hh>
+
+#include <functional>
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <cstdio>
+
+/*
+    EventLoop::pendingFunctors_ 微基准测试
+    对比 原来的 mutex + vector + swap 方案 和 无锁MpscQueue方案
+    分别使用1 4 16 64个生产者线程向同一个消费者线程投递回调
+*/
+
+using Functor = std::function<void()>;
+
+/* 原来的方案 queueInLoop加锁push_back doPendingFunctors加锁swap */
+class MutexSwapQueue {
+public:
+    void push(Functor cb) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        pending_.emplace_back(std::move(cb));
+    }
+    size_t drain() {
+        std::vector<Functor> functors;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            functors.swap(pending_);
+        }
+        for (const Functor& f : functors) {
+            f();
+        }
+        return functors.size();
+    }
+private:
+    std::vector<Functor> pending_;
+    std::mutex mutex_;
+};
+
+/* 现在的方案 无锁入队 消费者成批取出后执行 */
+class LockFreeQueue {
+public:
+    void push(Functor cb) { queue_.push(std::move(cb)); }
+    size_t drain() {
+        Functor f;
+        while (queue_.pop(&f)) {
+            batch_.push_back(std::move(f));
+        }
+        for (const Functor& f : batch_) {
+            f();
+        }
+        size_t n = batch_.size();
+        batch_.clear();
+        return n;
+    }
+private:
+    MpscQueue<Functor> queue_;
+    std::vector<Functor> batch_;
+};
+
+template <typename Queue>
+double run(int numProducers, int tasksPerProducer) {
+    Queue queue;
+    std::atomic_long executed{0};
+    const long total = static_cast<long>(numProducers) * tasksPerProducer;
+
+    Timestamp start(Timestamp::now());
+    std::vector<std::thread> producers;
+    for (int i = 0; i < numProducers; ++ i) {
+        producers.emplace_back([&]() {
+            for (int j = 0; j < tasksPerProducer; ++ j) {
+                queue.push([&executed]() { executed.fetch_add(1, std::memory_order_relaxed); });
+            }
+        });
+    }
+    /* 当前线程作为消费者(loop线程) */
+    long consumed = 0;
+    while (consumed < total) {
+        size_t n = queue.drain();
+        if (n == 0) {
+            std::this_thread::yield();
+        }
+        consumed += n;
+    }
+    for (std::thread& t : producers) {
+        t.join();
+    }
+    double seconds = timeDifference(Timestamp::now(), start);
+    return total / seconds;
+}
+
+int main() {
+    const int kTotalTasks = 2000000;
+    const int producerCounts[] = {1, 4, 16, 64};
+    printf("%10s %20s %20s\n", "producers", "mutex+swap (ops/s)", "mpsc (ops/s)");
+    for (int producers : producerCounts) {
+        int perProducer = kTotalTasks / producers;
+        double mutexOps = run<MutexSwapQueue>(producers, perProducer);
+        double mpscOps = run<LockFreeQueue>(producers, perProducer);
+        printf("%10d %20.0f %20.0f\n", producers, mutexOps, mpscOps);
+    }
+    return 0;
+}
@@ -0,0 +1,83 @@
+#include <mymuduo/net/EventLoop.hh>
+#include <mymuduo/net/EventLoopThread.hh>
+
+#include <functional>
+#include <memory>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+
+/*
+    统计每次queueInLoop投递回调时的内存分配次数
+    替换malloc 计数所有线程(包括libmymuduo内部 以及所有形式的operator new)的分配
+    不替换operator new/delete 避免只替换其中一部分形式造成分配和释放不配对
+
+    投递的回调和库内部的一样 是std::bind(&Class::method, shared_ptr)
+    对比 先包装成std::function再投递 和 直接投递(EventLoop::Functor即Task)
+*/
+
+static std::atomic_long g_allocs{0};
+
+/* glibc的malloc实现 */
+extern "C" void* __libc_malloc(size_t size);
+
+extern "C" void* malloc(size_t size) {
+    g_allocs.fetch_add(1, std::memory_order_relaxed);
+    return __libc_malloc(size);
+}
+
+/* 模拟TcpConnection */
+class Connection {
+public:
+    Connection() : count_(0) {}
+    void handle() { ++ count_; }
+    long count() const { return count_; }
+private:
+    long count_;
+};
+
+static const int kWarmup = 10000;
+static const int kTasks = 200000;
+
+template <typename Post>
+double measure(EventLoop* loop, const std::shared_ptr<Connection>& conn, Post post) {
+    /* 先投递一批 让MpscQueue的节点缓存进入稳定状态 */
+    long target = conn->count() + kWarmup;
+    for (int i = 0; i < kWarmup; ++ i) {
+        post(loop, conn);
+    }
+    while (conn->count() < target) {
+        usleep(1000);
+    }
+
+    target = conn->count() + kTasks;
+    long before = g_allocs.load();
+    for (int i = 0; i < kTasks; ++ i) {
+        post(loop, conn);
+    }
+    while (conn->count() < target) {
+        usleep(1000);
+    }
+    long allocs = g_allocs.load() - before;
+    return static_cast<double>(allocs) / kTasks;
+}
+
+int main() {
+    EventLoopThread thread;
+    EventLoop* loop = thread.startLoop();
+    std::shared_ptr<Connection> conn(new Connection);
+
+    double viaFunction = measure(loop, conn, [](EventLoop* l, const std::shared_ptr<Connection>& c) {
+        std::function<void()> f(std::bind(&Connection::handle, c));
+        l->queueInLoop(std::move(f));
+    });
+    double viaTask = measure(loop, conn, [](EventLoop* l, const std::shared_ptr<Connection>& c) {
+        l->queueInLoop(std::bind(&Connection::handle, c));
+    });
+
+    printf("sizeof(std::bind(&Connection::handle, shared_ptr)) = %zu, Task::kInlineSize = %zu\n",
+           sizeof(std::bind(&Connection::handle, conn)), Task::kInlineSize);
+    printf("allocations per posted task: std::function %.3f, Task %.3f\n", viaFunction, viaTask);
+    return 0;
+}
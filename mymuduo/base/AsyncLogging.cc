@@ -0,0 +1,157 @@
+#include "AsyncLogging.hh"
+#include "LogFile.hh"
+#include "Timestamp.hh"
+
+#include <stdio.h>
+#include <chrono>
+
+
+AsyncLogging::AsyncLogging(const std::string& basename, off_t rollSize,
+                           int flushInterval, size_t maxBuffers)
+    : basename_(basename)
+    , rollSize_(rollSize)
+    , flushInterval_(flushInterval)
+    , maxBuffers_(maxBuffers)
+    , running_(false)
+    , thread_(std::bind(&AsyncLogging::threadFunc, this), "AsyncLogging")
+    , currentBuffer_(new LogBuffer)
+    , nextBuffer_(new LogBuffer)
+    , flushRequested_(0)
+    , flushedGeneration_(0)
+    , droppedLines_(0)
+    {
+        buffers_.reserve(maxBuffers_);
+}
+
+AsyncLogging::~AsyncLogging() {
+    if (running_) {
+        stop();
+    }
+}
+
+/* 前端 写入一行日志 只拷贝内存 不做系统调用 */
+void AsyncLogging::append(const char* logline, size_t len) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (currentBuffer_->avail() > len) {
+        currentBuffer_->append(logline, len);
+        return;
+    }
+    /* 当前缓冲区写满了 */
+    if (buffers_.size() >= maxBuffers_) {
+        /* 后端跟不上 丢弃这条日志 不阻塞前端 */
+        droppedLines_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    buffers_.push_back(std::move(currentBuffer_));
+    if (nextBuffer_) {
+        currentBuffer_ = std::move(nextBuffer_);
+    } else {
+        /* 备用缓冲区也用完了 极少发生 */
+        currentBuffer_.reset(new LogBuffer);
+    }
+    currentBuffer_->append(logline, len);
+    cond_.notify_one();
+}
+
+/* 唤醒后端 立即写入当前缓冲区的日志 */
+void AsyncLogging::flush() {
+    cond_.notify_one();
+}
+
+/* 等待后端写完并fflush当前的所有日志 后端没有运行时直接返回 */
+void AsyncLogging::flushSync() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (!running_) {
+        return;
+    }
+    uint64_t generation = ++ flushRequested_;
+    cond_.notify_one();
+    flushedCond_.wait(lock, [this, generation]() { return flushedGeneration_ >= generation; });
+}
+
+void AsyncLogging::start() {
+    running_ = true;
+    thread_.start();
+}
+
+/* 停止后端线程 后端退出前会写完所有缓冲的日志 */
+void AsyncLogging::stop() {
+    {
+        /* 在锁内修改 后端检查running_和开始等待之间不会漏掉通知 */
+        std::lock_guard<std::mutex> lock(mutex_);
+        running_ = false;
+    }
+    cond_.notify_one();
+    thread_.join();
+}
+
+/* 后端线程函数 */
+void AsyncLogging::threadFunc() {
+    LogFile output(basename_, rollSize_, flushInterval_);
+    /* 两块空闲缓冲区 用来替换前端的当前缓冲区和备用缓冲区 */
+    BufferPtr newBuffer1(new LogBuffer);
+    BufferPtr newBuffer2(new LogBuffer);
+    BufferVector buffersToWrite;
+    buffersToWrite.reserve(maxBuffers_ + 1);
+    uint64_t reportedDrops = 0;
+
+    /* 最后一轮在running_为false之后执行 写完剩余的日志 */
+    bool stopping = false;
+    while (!stopping) {
+        uint64_t generation = 0; /* 本轮写完之后满足的flushSync请求 */
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            stopping = !running_;
+            if (buffers_.empty() && !stopping && flushRequested_ == flushedGeneration_) {
+                cond_.wait_for(lock, std::chrono::seconds(flushInterval_));
+            }
+            generation = flushRequested_;
+            /* 当前缓冲区也交给后端 即使没写满 */
+            buffers_.push_back(std::move(currentBuffer_));
+            currentBuffer_ = std::move(newBuffer1);
+            buffersToWrite.swap(buffers_);
+            if (!nextBuffer_) {
+                nextBuffer_ = std::move(newBuffer2);
+            }
+        }
+
+        /* 在锁外写文件 前端不会被磁盘IO阻塞 */
+        uint64_t drops = droppedLines_.load(std::memory_order_relaxed);
+        if (drops != reportedDrops) {
+            char buf[256];
+            int n = snprintf(buf, sizeof(buf), "[WARN]%s : AsyncLogging dropped %ju log lines\n",
+                             Timestamp::now().toString().c_str(),
+                             static_cast<uintmax_t>(drops - reportedDrops));
+            output.append(buf, static_cast<size_t>(n));
+            reportedDrops = drops;
+        }
+        for (const BufferPtr& buffer : buffersToWrite) {
+            output.append(buffer->data(), buffer->length());
+        }
+
+        /* 留下两块缓冲区复用 其余的释放 */
+        if (buffersToWrite.size() > 2) {
+            buffersToWrite.resize(2);
+        }
+        if (!newBuffer1) {
+            newBuffer1 = std::move(buffersToWrite.back());
+            buffersToWrite.pop_back();
+            newBuffer1->reset();
+        }
+        if (!newBuffer2) {
+            newBuffer2 = std::move(buffersToWrite.back());
+            buffersToWrite.pop_back();
+            newBuffer2->reset();
+        }
+        buffersToWrite.clear();
+        output.flush();
+
+        if (generation != 0) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (flushedGeneration_ != generation) {
+                flushedGeneration_ = generation;
+                flushedCond_.notify_all();
+            }
+        }
+    }
+}
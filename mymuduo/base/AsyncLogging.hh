@@ -0,0 +1,94 @@
+#ifndef   __ASYNCLOGGING_HH_
+#define   __ASYNCLOGGING_HH_
+
+#include "noncopyable.hh"
+#include "Thread.hh"
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <string.h>
+#include <sys/types.h>
+
+/*
+    AsyncLogging 异步日志 双缓冲
+    前端(写日志的线程)只把日志拷贝到当前缓冲区 不做任何系统调用
+    后端线程每flushInterval秒 或者有缓冲区写满时 把写满的缓冲区交换出来 写入LogFile
+
+    前端写满当前缓冲区后 换上备用缓冲区
+    已写满等待后端写入的缓冲区超过maxBuffers个时 说明后端跟不上 直接丢弃日志并计数 前端不会阻塞
+    后端下一次写文件时会记录丢弃了多少条日志
+
+    使用方法:
+        AsyncLogging log("server", 500 * 1024 * 1024);
+        log.start();
+        Logger::setOutput(std::bind(&AsyncLogging::append, &log, _1, _2));
+        Logger::setFlush(std::bind(&AsyncLogging::flush, &log));
+        Logger::setSyncFlush(std::bind(&AsyncLogging::flushSync, &log));
+*/
+class AsyncLogging : noncopyable {
+public:
+    AsyncLogging(const std::string& basename, off_t rollSize,
+                 int flushInterval = 3, size_t maxBuffers = 16);
+    ~AsyncLogging();
+
+    /* 前端 写入一行日志 */
+    void append(const char* logline, size_t len);
+    /* 唤醒后端 立即写入当前缓冲区的日志 不等待写入完成 */
+    void flush();
+    /* 等待后端把目前为止的日志写入文件并fflush之后返回 LOG_FATAL在exit之前调用 */
+    void flushSync();
+
+    /* 启动和停止后端线程 停止时会写完所有缓冲的日志 */
+    void start();
+    void stop();
+
+    /* 因为后端跟不上而丢弃的日志条数 */
+    uint64_t droppedLines() const { return droppedLines_.load(std::memory_order_relaxed); }
+private:
+    static const size_t kBufferSize = 4 * 1024 * 1024;
+
+    /* 固定大小的日志缓冲区 */
+    class LogBuffer : noncopyable {
+    public:
+        LogBuffer() : data_(new char[kBufferSize]), len_(0) {}
+        void append(const char* buf, size_t len) { memcpy(data_.get() + len_, buf, len); len_ += len; }
+        const char* data() const { return data_.get(); }
+        size_t length() const { return len_; }
+        size_t avail() const { return kBufferSize - len_; }
+        void reset() { len_ = 0; }
+    private:
+        std::unique_ptr<char[]> data_;
+        size_t len_;
+    };
+    using BufferPtr = std::unique_ptr<LogBuffer>;
+    using BufferVector = std::vector<BufferPtr>;
+
+    /* 后端线程函数 */
+    void threadFunc();
+
+    const std::string basename_;
+    const off_t rollSize_;
+    const int flushInterval_;
+    const size_t maxBuffers_;  /* 最多缓存多少个写满的缓冲区 */
+
+    std::atomic_bool running_;
+    Thread thread_;
+
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    BufferPtr currentBuffer_;  /* 当前缓冲区 */
+    BufferPtr nextBuffer_;     /* 备用缓冲区 */
+    BufferVector buffers_;     /* 写满了 等待后端写入的缓冲区 */
+    std::condition_variable flushedCond_;
+    uint64_t flushRequested_;  /* flushSync请求的次数 */
+    uint64_t flushedGeneration_; /* 后端已经写完的flushSync请求 */
+
+    std::atomic<uint64_t> droppedLines_;
+};
+
+
+#endif // __ASYNCLOGGING_HH_
@@ -0,0 +1,120 @@
+#include "LogFile.hh"
+
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+
+
+LogFile::LogFile(const std::string& basename, off_t rollSize, int flushInterval)
+    : basename_(basename)
+    , rollSize_(rollSize)
+    , flushInterval_(flushInterval)
+    , fp_(nullptr)
+    , writtenBytes_(0)
+    , count_(0)
+    , startOfPeriod_(0)
+    , lastRoll_(0)
+    , lastFlush_(0)
+    {
+        rollFile();
+}
+
+LogFile::~LogFile() {
+    if (fp_ != nullptr) {
+        ::fclose(fp_);
+    }
+}
+
+/* 写入日志 */
+void LogFile::append(const char* logline, size_t len) {
+    if (fp_ == nullptr) {
+        return;
+    }
+    /* 只有后台线程使用 不需要stdio的锁 */
+    size_t written = 0;
+    while (written < len) {
+        size_t n = ::fwrite_unlocked(logline + written, 1, len - written, fp_);
+        if (n == 0) {
+            int err = ::ferror(fp_);
+            if (err) {
+                fprintf(stderr, "LogFile::append() failed %s\n", strerror(err));
+            }
+            break;
+        }
+        written += n;
+    }
+    writtenBytes_ += written;
+
+    if (writtenBytes_ > rollSize_) {
+        rollFile();
+    } else if (++ count_ >= kCheckTimeEveryN) {
+        /* 不是每次都取时间 */
+        count_ = 0;
+        time_t now = ::time(nullptr);
+        time_t thisPeriod = now / kRollPerSeconds * kRollPerSeconds;
+        if (thisPeriod != startOfPeriod_) {
+            rollFile();
+        } else if (now - lastFlush_ > flushInterval_) {
+            lastFlush_ = now;
+            ::fflush(fp_);
+        }
+    }
+}
+
+/* 刷新到内核 */
+void LogFile::flush() {
+    if (fp_ != nullptr) {
+        ::fflush(fp_);
+    }
+}
+
+/* 新建一个日志文件 */
+bool LogFile::rollFile() {
+    time_t now = 0;
+    std::string filename = getLogFileName(basename_, &now);
+    time_t start = now / kRollPerSeconds * kRollPerSeconds;
+    /* 同一秒内不重复滚动 文件名会相同 */
+    if (now <= lastRoll_) {
+        return false;
+    }
+    FILE* fp = ::fopen(filename.c_str(), "ae"); /* e: O_CLOEXEC */
+    if (fp == nullptr) {
+        fprintf(stderr, "LogFile::rollFile() open %s failed: %d\n", filename.c_str(), errno);
+        return false;
+    }
+    if (fp_ != nullptr) {
+        ::fclose(fp_);
+    }
+    fp_ = fp;
+    ::setbuffer(fp_, buffer_, sizeof(buffer_));
+    writtenBytes_ = 0;
+    lastRoll_ = now;
+    lastFlush_ = now;
+    startOfPeriod_ = start;
+    return true;
+}
+
+/* 生成日志文件名 basename.yyyymmdd-hhmmss.hostname.pid.log */
+std::string LogFile::getLogFileName(const std::string& basename, time_t* now) {
+    std::string filename(basename);
+
+    char timebuf[32];
+    struct tm tm;
+    *now = ::time(nullptr);
+    ::localtime_r(now, &tm);
+    ::strftime(timebuf, sizeof(timebuf), ".%Y%m%d-%H%M%S.", &tm);
+    filename += timebuf;
+
+    char hostname[256];
+    if (::gethostname(hostname, sizeof(hostname)) == 0) {
+        hostname[sizeof(hostname) - 1] = '\0';
+        filename += hostname;
+    } else {
+        filename += "unknownhost";
+    }
+
+    char pidbuf[32];
+    snprintf(pidbuf, sizeof(pidbuf), ".%d.log", ::getpid());
+    filename += pidbuf;
+    return filename;
+}
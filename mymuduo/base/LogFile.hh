@@ -0,0 +1,51 @@
+#ifndef   __LOGFILE_HH_
+#define   __LOGFILE_HH_
+
+#include "noncopyable.hh"
+
+#include <string>
+#include <stdio.h>
+#include <time.h>
+#include <sys/types.h>
+
+/*
+    LogFile 日志文件 由AsyncLogging的后台线程独占使用 不加锁
+    文件名: basename.yyyymmdd-hhmmss.hostname.pid.log
+    滚动: 写入的字节数超过rollSize 或者跨过了一天 就新建一个日志文件
+    刷新: 距上次刷新超过flushInterval秒时刷新到内核
+*/
+class LogFile : noncopyable {
+public:
+    LogFile(const std::string& basename, off_t rollSize, int flushInterval = 3);
+    ~LogFile();
+
+    /* 写入日志 */
+    void append(const char* logline, size_t len);
+    /* 刷新到内核 */
+    void flush();
+    /* 新建一个日志文件 */
+    bool rollFile();
+
+private:
+    /* 生成日志文件名 */
+    static std::string getLogFileName(const std::string& basename, time_t* now);
+
+    static const int kRollPerSeconds = 60 * 60 * 24; /* 每天滚动一次 */
+    static const int kCheckTimeEveryN = 1024;        /* 每写入多少次检查一次时间 */
+
+    const std::string basename_;
+    const off_t rollSize_;
+    const int flushInterval_;
+
+    FILE* fp_;
+    char buffer_[64 * 1024]; /* FILE的用户态缓冲区 */
+    off_t writtenBytes_;     /* 当前文件已经写入的字节数 */
+    int count_;              /* 距上次检查时间之后写入的次数 */
+
+    time_t startOfPeriod_;   /* 当前文件所在的那一天的开始时间 */
+    time_t lastRoll_;        /* 上次滚动的时间 */
+    time_t lastFlush_;       /* 上次刷新的时间 */
+};
+
+
+#endif // __LOGFILE_HH_
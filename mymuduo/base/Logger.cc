@@ -1,7 +1,38 @@
 #include "Logger.hh"
 #include "Timestamp.hh"
 
-#include <iostream>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <algorithm>
+
+/* 运行时的日志级别 默认和编译期的最低级别相同 指定了MUDEBUG时为DEBUG 否则为INFO */
+std::atomic_int Logger::s_logLevel_{MYMUDUO_LOG_MIN_LEVEL};
+
+/* 每个级别日志的前缀 */
+static const char* const kLevelNames[] = {
+    "[DEBUG]",
+    "[INFO]",
+    "[WARN]",
+    "[ERROR]",
+    "[FATAL]",
+};
+
+/* 默认输出到stdout 一次fwrite写完一行 stdio自带锁 多个线程的日志不会交错 */
+static void defaultOutput(const char* msg, size_t len) {
+    fwrite(msg, 1, len, stdout);
+}
+
+static void defaultFlush() {
+    fflush(stdout);
+}
+
+Logger::Logger()
+    : output_(defaultOutput)
+    , flush_(defaultFlush)
+    , syncFlush_(defaultFlush)
+    {
+}
 
 /* 获取Logger唯一的实例对象 */
 Logger& Logger::instance() {
@@ -9,28 +40,37 @@ Logger& Logger::instance() {
     return logger;
 }
 
-/* 设置日志级别 */
-void Logger::setLogLevel(int level){
-    logLevel_ = level;
-}
-
-/* 写日志接口 */
-void Logger::log(std::string msg){
+/* 写日志接口 格式化并输出一行日志 */
+void Logger::log(int level, const char* format, ...) {
     /* 日志格式： [级别信息] time : msg */
-    switch (logLevel_) {
-        case INFO: 
-            std::cout << "[INFO]";
-            break;
-        case ERROR: 
-            std::cout << "[ERROR]";
-            break;
-        case FATAL: 
-            std::cout << "[FATAL]";
-            break;
-        case DEBUG: 
-            std::cout << "[DEBUG]";
-            break;
+    char buf[1024]; /* 不需要清零 长度由snprintf的返回值确定 */
+    size_t len = strlen(kLevelNames[level]);
+    memcpy(buf, kLevelNames[level], len);
+    /* 时间戳使用线程缓存的格式化结果 同一秒内不调用localtime */
+    len += Timestamp::now().formatTo(buf + len, sizeof(buf) - len);
+    memcpy(buf + len, " : ", 3);
+    len += 3;
+
+    va_list args;
+    va_start(args, format);
+    int m = vsnprintf(buf + len, sizeof(buf) - len, format, args);
+    va_end(args);
+    if (m > 0) {
+        len = std::min(len + static_cast<size_t>(m), sizeof(buf) - 1);
+    }
+
+    /* 消息中自带的换行去掉 统一在末尾加一个换行 */
+    while (len > 0 && buf[len - 1] == '\n') {
+        -- len;
+    }
+    buf[len ++] = '\n';
+
+    output_(buf, len);
+    if (level == FATAL) {
+        /* 之后马上exit 必须等日志真正写出 */
+        syncFlush_();
+    } else if (level >= ERROR) {
+        /* 错误日志立即刷出 普通日志交给输出端缓冲 */
+        flush_();
     }
-    /* 打印time和msg */
-    std::cout << Timestamp::now().toString() << " : " << msg << std::endl;
 }
@@ -2,70 +2,102 @@
 #define   __LOGGER_HH_
 
 #include <string>
+#include <atomic>
+#include <functional>
 #include <stdlib.h>
 
 #include "noncopyable.hh"
 
-/* 定义四个宏 对应使用四个级别的日志 */
+/*
+    日志级别的数值 供预处理器使用 和LogLevel枚举一一对应
+*/
+#define MYMUDUO_LOG_LEVEL_DEBUG 0
+#define MYMUDUO_LOG_LEVEL_INFO  1
+#define MYMUDUO_LOG_LEVEL_WARN  2
+#define MYMUDUO_LOG_LEVEL_ERROR 3
+#define MYMUDUO_LOG_LEVEL_FATAL 4
 
-/* LOG_INFO("%s %d", arg1, arg2) */
-#define LOG_INFO(logmsgFormat, ...) \
+/*
+    编译期的最低日志级别 低于该级别的LOG_XXX宏不产生任何运行时的代码
+    可以在编译时通过 -DMYMUDUO_LOG_MIN_LEVEL=MYMUDUO_LOG_LEVEL_WARN 指定
+
+    对于调试信息 我们仅在调试时进行使用 正常使用时输出大量调试信息会降低效率
+    当指定了MUDEBUG时输出调试信息 未指定时不输出调试信息
+*/
+#ifndef MYMUDUO_LOG_MIN_LEVEL
+#ifdef MUDEBUG
+#define MYMUDUO_LOG_MIN_LEVEL MYMUDUO_LOG_LEVEL_DEBUG
+#else
+#define MYMUDUO_LOG_MIN_LEVEL MYMUDUO_LOG_LEVEL_INFO
+#endif
+#endif
+
+/*
+    先检查运行时的日志级别 再进行格式化
+    日志级别不够时 参数不会被求值 也没有格式化和写日志的开销
+*/
+#define MYMUDUO_LOG(level, logmsgFormat, ...) \
     do { \
-        Logger& logger = Logger::instance(); \
-        logger.setLogLevel(INFO); \
-        char buf[1024] = {0}; \
-        snprintf(buf, 1024, logmsgFormat, ##__VA_ARGS__); \
-        logger.log(buf); \
+        if (Logger::logLevel() <= level) { \
+            Logger::instance().log(level, logmsgFormat, ##__VA_ARGS__); \
+        } \
     } while(0)
 /*
-    snprintf将格式化的字符串拷贝到buf中
     ##__VA_ARGS__表示可变参数 如果可变参数为空 它会自动去掉前面的逗号
 */
-
-#define LOG_ERROR(logmsgFormat, ...) \
+/*
+    编译期去掉的级别 if (0)中的代码会被编译器删除 没有运行时开销
+    参数仍然算作被使用(不会产生unused警告) 格式串仍然会被检查
+*/
+#define MYMUDUO_LOG_DISABLED(level, logmsgFormat, ...) \
     do { \
-        Logger& logger = Logger::instance(); \
-        logger.setLogLevel(ERROR); \
-        char buf[1024] = {0}; \
-        snprintf(buf, 1024, logmsgFormat, ##__VA_ARGS__); \
-        logger.log(buf); \
+        if (0) { \
+            Logger::instance().log(level, logmsgFormat, ##__VA_ARGS__); \
+        } \
     } while(0)
 
-/* 如果严重错误 执行exit(-1) 退出程序 */
+/* 定义五个宏 对应使用五个级别的日志 */
+
+/* LOG_INFO("%s %d", arg1, arg2) */
+#if MYMUDUO_LOG_MIN_LEVEL <= MYMUDUO_LOG_LEVEL_DEBUG
+#define LOG_DEBUG(logmsgFormat, ...) MYMUDUO_LOG(DEBUG, logmsgFormat, ##__VA_ARGS__)
+#else
+#define LOG_DEBUG(logmsgFormat, ...) MYMUDUO_LOG_DISABLED(DEBUG, logmsgFormat, ##__VA_ARGS__)
+#endif
+
+#if MYMUDUO_LOG_MIN_LEVEL <= MYMUDUO_LOG_LEVEL_INFO
+#define LOG_INFO(logmsgFormat, ...) MYMUDUO_LOG(INFO, logmsgFormat, ##__VA_ARGS__)
+#else
+#define LOG_INFO(logmsgFormat, ...) MYMUDUO_LOG_DISABLED(INFO, logmsgFormat, ##__VA_ARGS__)
+#endif
+
+#if MYMUDUO_LOG_MIN_LEVEL <= MYMUDUO_LOG_LEVEL_WARN
+#define LOG_WARN(logmsgFormat, ...) MYMUDUO_LOG(WARN, logmsgFormat, ##__VA_ARGS__)
+#else
+#define LOG_WARN(logmsgFormat, ...) MYMUDUO_LOG_DISABLED(WARN, logmsgFormat, ##__VA_ARGS__)
+#endif
+
+#if MYMUDUO_LOG_MIN_LEVEL <= MYMUDUO_LOG_LEVEL_ERROR
+#define LOG_ERROR(logmsgFormat, ...) MYMUDUO_LOG(ERROR, logmsgFormat, ##__VA_ARGS__)
+#else
+#define LOG_ERROR(logmsgFormat, ...) MYMUDUO_LOG_DISABLED(ERROR, logmsgFormat, ##__VA_ARGS__)
+#endif
+
+/* 如果严重错误 执行exit(-1) 退出程序 FATAL日志总是输出 */
 #define LOG_FATAL(logmsgFormat, ...) \
     do { \
-        Logger& logger = Logger::instance(); \
-        logger.setLogLevel(FATAL); \
-        char buf[1024] = {0}; \
-        snprintf(buf, 1024, logmsgFormat, ##__VA_ARGS__); \
-        logger.log(buf); \
+        Logger::instance().log(FATAL, logmsgFormat, ##__VA_ARGS__); \
         exit(-1); \
     } while(0)
 
-/* 
-    对于调试信息 我们仅在调试时进行使用 正常使用时输出大量调试信息会降低效率
-    当指定了MUDEBUG时输出调试信息 未指定时不输出调试信息(使用空宏)
-*/
-#ifdef MUDEBUG
-#define LOG_DEBUG(logmsgFormat, ...) \
-    do { \
-        Logger& logger = Logger::instance(); \
-        logger.setLogLevel(DEBUG); \
-        char buf[1024] = {0}; \
-        snprintf(buf, 1024, logmsgFormat, ##__VA_ARGS__); \
-        logger.log(buf); \
-    } while(0)
-#else
-#define LOG_DEBUG(logmsgFormat, ...)
-#endif
-
 
-/* 定义日志的级别 */
+/* 定义日志的级别 从低到高 */
 enum LogLevel {
-    INFO,   // 普通信息
-    ERROR,  // 错误信息
-    FATAL,  // core信息
-    DEBUG   // 调试信息
+    DEBUG = MYMUDUO_LOG_LEVEL_DEBUG,  // 调试信息
+    INFO = MYMUDUO_LOG_LEVEL_INFO,    // 普通信息
+    WARN = MYMUDUO_LOG_LEVEL_WARN,    // 警告信息
+    ERROR = MYMUDUO_LOG_LEVEL_ERROR,  // 错误信息
+    FATAL = MYMUDUO_LOG_LEVEL_FATAL   // core信息
 };
 
 
@@ -74,14 +106,36 @@ class Logger : noncopyable {
 public:
     /* 获取Logger唯一的实例对象 */
     static Logger& instance();
-    /* 设置日志级别 */
-    void setLogLevel(int level);
-    /* 写日志接口 */
-    void log(std::string msg);
+
+    /* 运行时的日志级别 低于该级别的日志不输出 默认为MYMUDUO_LOG_MIN_LEVEL */
+    static int logLevel() { return s_logLevel_.load(std::memory_order_relaxed); }
+    static void setLogLevel(int level) { s_logLevel_.store(level, std::memory_order_relaxed); }
+
+    /* 日志的输出和刷新函数 默认输出到stdout */
+    using OutputFunc = std::function<void(const char* msg, size_t len)>;
+    using FlushFunc = std::function<void()>;
+
+    /*
+        替换日志的输出目的地 如AsyncLogging::append
+        不加锁 需要在其他线程开始写日志之前设置
+    */
+    static void setOutput(OutputFunc output) { instance().output_ = std::move(output); }
+    /* ERROR级别的日志输出后调用 */
+    static void setFlush(FlushFunc flush) { instance().flush_ = std::move(flush); }
+    /* FATAL日志输出后 exit之前调用 返回时日志必须已经写出 如AsyncLogging::flushSync */
+    static void setSyncFlush(FlushFunc flush) { instance().syncFlush_ = std::move(flush); }
+
+    /* 写日志接口 格式化并输出一行日志 */
+    void log(int level, const char* format, ...) __attribute__((format(printf, 3, 4)));
 private:
-    Logger() {}
-    int logLevel_;
+    Logger();
+
+    static std::atomic_int s_logLevel_;
+
+    OutputFunc output_;
+    FlushFunc flush_;
+    FlushFunc syncFlush_;
 };
 
 
-#endif // __LOGGER_HH_
\ No newline at end of file
+#endif // __LOGGER_HH_
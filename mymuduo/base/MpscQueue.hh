@@ -0,0 +1,140 @@
+#ifndef   __MPSCQUEUE_HH_
+#define   __MPSCQUEUE_HH_
+
+#include "noncopyable.hh"
+
+#include <atomic>
+#include <utility>
+
+/*
+    MpscQueue 无锁的多生产者单消费者队列 (Dmitry Vyukov的MPSC节点队列)
+
+           tail_(消费者)                          head_(生产者)
+              |                                      |
+              v                                      v
+            [stub] --next--> [node1] --next--> ... [nodeN] --next--> nullptr
+
+    push: 任意线程调用 一次原子exchange把新节点挂到head_上 然后链接前驱的next
+          不会被其他生产者阻塞 也没有CAS重试
+    pop:  只能由唯一的消费者线程调用 tail_指向的始终是一个已经取走值的哑节点
+          它的next就是下一个待取的元素 取走值后next成为新的哑节点 释放旧的哑节点
+
+    注意 生产者在exchange之后 链接next之前 消费者会暂时看到队列为空
+    这个元素会在下一次pop时被取到 调用者需要保证之后会再次消费(EventLoop中由wakeup保证)
+
+    节点回收: 消费者释放的节点不交还给malloc 而是压入同类型队列共享的空闲链表s_freeNodes_
+    生产者每次从自己线程的缓存t_cache_中取节点 缓存空了就用exchange一次性取走整个空闲链表
+    (只有整体取走 没有单个弹出 所以不存在ABA问题) 稳定运行后push不再分配内存
+*/
+template <typename T>
+class MpscQueue : noncopyable {
+public:
+    MpscQueue()
+        : head_(new Node())
+        , pad_()
+        , tail_(head_.load(std::memory_order_relaxed))
+        {
+    }
+    ~MpscQueue() {
+        T value;
+        while (pop(&value)) {
+        }
+        delete tail_;
+    }
+
+    /* 入队 任意线程都可以调用 */
+    void push(T value) {
+        Node* node = allocNode();
+        node->value = std::move(value);
+        /* 把新节点设为head_ 取得前驱节点 */
+        Node* prev = head_.exchange(node, std::memory_order_acq_rel);
+        /* 链接到前驱节点之后 消费者从这里开始可以看到该节点 */
+        prev->next.store(node, std::memory_order_release);
+    }
+
+    /* 出队 只能由消费者线程调用 队列为空时返回false */
+    bool pop(T* value) {
+        Node* tail = tail_;
+        Node* next = tail->next.load(std::memory_order_acquire);
+        if (next == nullptr) {
+            return false;
+        }
+        /* next成为新的哑节点 它的值被取走 */
+        *value = std::move(next->value);
+        tail_ = next;
+        freeNode(tail);
+        return true;
+    }
+
+    /* 队列是否为空 只能由消费者线程调用 */
+    bool empty() const {
+        return tail_->next.load(std::memory_order_acquire) == nullptr;
+    }
+
+private:
+    struct Node {
+        Node() : next(nullptr) {}
+
+        std::atomic<Node*> next;
+        T value;
+    };
+
+    /* 生产者线程的节点缓存 线程退出时释放 */
+    struct NodeCache {
+        NodeCache() : head(nullptr) {}
+        ~NodeCache() {
+            while (head != nullptr) {
+                Node* node = head;
+                head = node->next.load(std::memory_order_relaxed);
+                delete node;
+            }
+        }
+        Node* head;
+    };
+
+    /* 取一个空节点 优先使用回收的节点 */
+    static Node* allocNode() {
+        NodeCache& cache = t_cache_;
+        if (cache.head == nullptr) {
+            /* 整体取走空闲链表 */
+            cache.head = s_freeNodes_.exchange(nullptr, std::memory_order_acquire);
+            if (cache.head == nullptr) {
+                return new Node();
+            }
+        }
+        Node* node = cache.head;
+        cache.head = node->next.load(std::memory_order_relaxed);
+        node->next.store(nullptr, std::memory_order_relaxed);
+        return node;
+    }
+
+    /* 回收节点 压入空闲链表 */
+    static void freeNode(Node* node) {
+        node->value = T(); /* 值已经被取走 这里确保不再持有任何资源 */
+        Node* head = s_freeNodes_.load(std::memory_order_relaxed);
+        do {
+            node->next.store(head, std::memory_order_relaxed);
+        } while (!s_freeNodes_.compare_exchange_weak(head, node,
+                                                     std::memory_order_release,
+                                                     std::memory_order_relaxed));
+    }
+
+    static std::atomic<Node*> s_freeNodes_; /* 所有消费者回收的节点 */
+    static thread_local NodeCache t_cache_;  /* 当前线程缓存的节点 */
+
+    static const int kCacheLineSize = 64;
+
+    /* 生产者和消费者访问的成员用填充隔开 放在不同的cache line上 避免伪共享 */
+    std::atomic<Node*> head_; /* 最新入队的节点 生产者共享 */
+    char pad_[kCacheLineSize - sizeof(std::atomic<Node*>)];
+    Node* tail_;              /* 哑节点 仅消费者访问 */
+};
+
+template <typename T>
+std::atomic<typename MpscQueue<T>::Node*> MpscQueue<T>::s_freeNodes_{nullptr};
+
+template <typename T>
+thread_local typename MpscQueue<T>::NodeCache MpscQueue<T>::t_cache_;
+
+
+#endif // __MPSCQUEUE_HH_
@@ -0,0 +1,91 @@
+#include "SlabPool.hh"
+#include "CurrentThread.hh"
+#include "Logger.hh"
+
+#include <new>
+#include <string.h>
+
+
+SlabPool::SlabPool(pid_t ownerTid)
+    : ownerTid_(ownerTid)
+    , chunkCur_(nullptr)
+    , chunkEnd_(nullptr)
+    , remoteFrees_(nullptr)
+    {
+        memset(freeLists_, 0, sizeof(freeLists_));
+}
+
+SlabPool::~SlabPool() {
+    for (void* chunk : chunks_) {
+        ::operator delete(chunk);
+    }
+}
+
+void* SlabPool::allocate(size_t size) {
+    if (size > kMaxSize) {
+        return ::operator new(size);
+    }
+    if (CurrentThread::tid() != ownerTid_) {
+        /* 空闲链表没有加锁 只能由所属线程分配 */
+        LOG_FATAL("SlabPool::allocate in thread %d, owner is thread %d \n", CurrentThread::tid(), ownerTid_);
+    }
+    size_t sizeClass = sizeClassOf(size);
+    if (freeLists_[sizeClass] == nullptr) {
+        drainRemoteFrees();
+        if (freeLists_[sizeClass] == nullptr) {
+            return carve(sizeClass);
+        }
+    }
+    FreeNode* node = freeLists_[sizeClass];
+    freeLists_[sizeClass] = node->next;
+    return node;
+}
+
+void SlabPool::deallocate(void* p, size_t size) {
+    if (p == nullptr) {
+        return;
+    }
+    if (size > kMaxSize) {
+        ::operator delete(p);
+        return;
+    }
+    size_t sizeClass = sizeClassOf(size);
+    FreeNode* node = static_cast<FreeNode*>(p);
+    if (CurrentThread::tid() == ownerTid_) {
+        node->next = freeLists_[sizeClass];
+        freeLists_[sizeClass] = node;
+        return;
+    }
+    /* 其他线程释放 压入remoteFrees_ 由所属线程取走 */
+    node->sizeClass = sizeClass;
+    FreeNode* head = remoteFrees_.load(std::memory_order_relaxed);
+    do {
+        node->next = head;
+    } while (!remoteFrees_.compare_exchange_weak(head, node, std::memory_order_release, std::memory_order_relaxed));
+}
+
+void SlabPool::drainRemoteFrees() {
+    if (remoteFrees_.load(std::memory_order_relaxed) == nullptr) {
+        return;
+    }
+    FreeNode* node = remoteFrees_.exchange(nullptr, std::memory_order_acquire);
+    while (node != nullptr) {
+        FreeNode* next = node->next;
+        node->next = freeLists_[node->sizeClass];
+        freeLists_[node->sizeClass] = node;
+        node = next;
+    }
+}
+
+void* SlabPool::carve(size_t sizeClass) {
+    size_t bytes = sizeClass * kAlignment;
+    if (static_cast<size_t>(chunkEnd_ - chunkCur_) < bytes) {
+        /* 当前chunk剩余的部分不够 丢弃剩余部分 申请新的chunk */
+        chunkCur_ = static_cast<char*>(::operator new(kChunkSize));
+        chunkEnd_ = chunkCur_ + kChunkSize;
+        chunks_.push_back(chunkCur_);
+    }
+    void* p = chunkCur_;
+    chunkCur_ += bytes;
+    return p;
+}
@@ -0,0 +1,102 @@
+#ifndef   __SLABPOOL_HH_
+#define   __SLABPOOL_HH_
+
+#include "noncopyable.hh"
+
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <stddef.h>
+#include <unistd.h>
+
+/*
+    SlabPool 属于一个线程(EventLoop)的小对象内存池
+
+    按16字节划分大小类 每个大小类一个空闲链表 空闲链表为空时从64K的chunk中顺序切出新对象
+    chunk直接向malloc申请 对象释放后回到空闲链表 不再交还给malloc 稳定运行后分配和释放都不调用malloc
+
+    只能在所属线程中分配
+    释放可以在任意线程中进行 其他线程释放的对象用CAS压入remoteFrees_
+    所属线程在空闲链表为空时用exchange一次性取走整个remoteFrees_ (只有整体取走 不存在ABA问题)
+
+    超过kMaxSize的对象直接使用::operator new/delete
+    释放时需要传入分配时的大小 配合SlabAllocator使用时由容器和shared_ptr传入
+*/
+class SlabPool : noncopyable {
+public:
+    static const size_t kAlignment = 16;
+    static const size_t kMaxSize = 4096;
+    static const size_t kChunkSize = 64 * 1024;
+
+    /* ownerTid为所属线程的tid */
+    explicit SlabPool(pid_t ownerTid);
+    /* 释放所有chunk 此后不能再有未释放的对象被使用 */
+    ~SlabPool();
+
+    void* allocate(size_t size);
+    void deallocate(void* p, size_t size);
+
+    /* 向malloc申请的chunk数量 只能在所属线程中调用 */
+    size_t numChunks() const { return chunks_.size(); }
+
+private:
+    /* 空闲对象的前16字节 */
+    struct FreeNode {
+        FreeNode* next;
+        size_t sizeClass;
+    };
+    static const size_t kNumClasses = kMaxSize / kAlignment + 1;
+
+    static size_t sizeClassOf(size_t size) {
+        return size == 0 ? 1 : (size + kAlignment - 1) / kAlignment;
+    }
+    /* 取走其他线程释放的对象 放回各自的空闲链表 */
+    void drainRemoteFrees();
+    /* 从chunk中切出一个新对象 */
+    void* carve(size_t sizeClass);
+
+    const pid_t ownerTid_;
+    FreeNode* freeLists_[kNumClasses]; /* 下标为大小类 对象大小为sizeClass * kAlignment */
+    char* chunkCur_;                   /* 当前chunk中未使用部分的起止位置 */
+    char* chunkEnd_;
+    std::vector<void*> chunks_;
+    std::atomic<FreeNode*> remoteFrees_; /* 其他线程释放的对象 */
+};
+
+
+/*
+    使用SlabPool的STL分配器 持有SlabPool的shared_ptr
+    分配器的副本存在容器和shared_ptr的控制块中 SlabPool在所有对象释放之后才会析构
+    用于std::allocate_shared时 对象和控制块在一次分配中得到
+*/
+template <typename T>
+class SlabAllocator {
+public:
+    using value_type = T;
+
+    explicit SlabAllocator(std::shared_ptr<SlabPool> pool) : pool_(std::move(pool)) {}
+    /* 只允许拷贝 移动之后源对象也必须可用(容器移动之后仍可能用源对象的分配器) */
+    SlabAllocator(const SlabAllocator& other) : pool_(other.pool_) {}
+    template <typename U>
+    SlabAllocator(const SlabAllocator<U>& other) : pool_(other.pool()) {}
+
+    T* allocate(size_t n) { return static_cast<T*>(pool_->allocate(n * sizeof(T))); }
+    void deallocate(T* p, size_t n) { pool_->deallocate(p, n * sizeof(T)); }
+
+    const std::shared_ptr<SlabPool>& pool() const { return pool_; }
+
+private:
+    std::shared_ptr<SlabPool> pool_;
+};
+
+template <typename T, typename U>
+inline bool operator==(const SlabAllocator<T>& lhs, const SlabAllocator<U>& rhs) {
+    return lhs.pool() == rhs.pool();
+}
+template <typename T, typename U>
+inline bool operator!=(const SlabAllocator<T>& lhs, const SlabAllocator<U>& rhs) {
+    return lhs.pool() != rhs.pool();
+}
+
+
+#endif // __SLABPOOL_HH_
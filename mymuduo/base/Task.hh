@@ -0,0 +1,138 @@
+#ifndef   __TASK_HH_
+#define   __TASK_HH_
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+/*
+    Task 只能移动的无返回值可调用对象 用作EventLoop::Functor
+
+    std::function的小对象缓冲区只有16字节
+    std::bind(&TcpConnection::xxx, conn)这样绑定了成员函数指针和shared_ptr的对象就有32字节
+    每次queueInLoop都会malloc/free一次
+    Task内置kInlineSize字节的缓冲区 能放下的可调用对象直接构造在缓冲区中 不需要分配内存
+    只有超过kInlineSize的可调用对象才会在堆上分配
+
+    Task不可拷贝 所以也可以保存只能移动的可调用对象
+*/
+class Task {
+public:
+    static const size_t kInlineSize = 64; /* 内置缓冲区大小 */
+
+    Task() : ops_(nullptr) {}
+    Task(std::nullptr_t) : ops_(nullptr) {}
+
+    /* 从任意可调用对象构造 */
+    template <typename F,
+              typename = typename std::enable_if<
+                  !std::is_same<typename std::decay<F>::type, Task>::value>::type>
+    Task(F&& f) : ops_(nullptr) {
+        using Functor = typename std::decay<F>::type;
+        construct<Functor>(std::forward<F>(f), std::integral_constant<bool, fitsInline<Functor>()>());
+    }
+
+    Task(Task&& other) noexcept : ops_(other.ops_) {
+        if (ops_ != nullptr) {
+            ops_->move(&storage_, &other.storage_);
+            other.ops_ = nullptr;
+        }
+    }
+    Task& operator=(Task&& other) noexcept {
+        if (this != &other) {
+            reset();
+            ops_ = other.ops_;
+            if (ops_ != nullptr) {
+                ops_->move(&storage_, &other.storage_);
+                other.ops_ = nullptr;
+            }
+        }
+        return *this;
+    }
+    Task& operator=(std::nullptr_t) {
+        reset();
+        return *this;
+    }
+
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+
+    ~Task() { reset(); }
+
+    /* 执行 和std::function一样 const对象也可以调用 */
+    void operator()() const { ops_->invoke(&storage_); }
+
+    explicit operator bool() const { return ops_ != nullptr; }
+
+    /* 可调用对象F是否可以直接放在内置缓冲区中 */
+    template <typename F>
+    static constexpr bool fitsInline() {
+        return sizeof(F) <= kInlineSize
+            && alignof(F) <= alignof(Storage)
+            && std::is_nothrow_move_constructible<F>::value;
+    }
+
+private:
+    using Storage = typename std::aligned_storage<kInlineSize, alignof(std::max_align_t)>::type;
+
+    /* 每种可调用对象类型对应一组操作函数 相当于手写的虚函数表 */
+    struct Ops {
+        void (*invoke)(void* storage);
+        void (*move)(void* dst, void* src);   /* 移动到dst 并析构src */
+        void (*destroy)(void* storage);
+    };
+
+    /* 可调用对象直接构造在内置缓冲区中 */
+    template <typename F>
+    struct InlineOps {
+        static void invoke(void* s) { (*static_cast<F*>(s))(); }
+        static void move(void* dst, void* src) {
+            F* f = static_cast<F*>(src);
+            ::new (dst) F(std::move(*f));
+            f->~F();
+        }
+        static void destroy(void* s) { static_cast<F*>(s)->~F(); }
+        static const Ops* ops() {
+            static const Ops kOps = { &invoke, &move, &destroy };
+            return &kOps;
+        }
+    };
+
+    /* 可调用对象太大 在堆上构造 内置缓冲区中只保存指针 */
+    template <typename F>
+    struct HeapOps {
+        static F*& ptr(void* s) { return *static_cast<F**>(s); }
+        static void invoke(void* s) { (*ptr(s))(); }
+        static void move(void* dst, void* src) { ::new (dst) F*(ptr(src)); }
+        static void destroy(void* s) { delete ptr(s); }
+        static const Ops* ops() {
+            static const Ops kOps = { &invoke, &move, &destroy };
+            return &kOps;
+        }
+    };
+
+    template <typename F, typename Arg>
+    void construct(Arg&& f, std::true_type /* inline */) {
+        ::new (static_cast<void*>(&storage_)) F(std::forward<Arg>(f));
+        ops_ = InlineOps<F>::ops();
+    }
+    template <typename F, typename Arg>
+    void construct(Arg&& f, std::false_type /* heap */) {
+        ::new (static_cast<void*>(&storage_)) F*(new F(std::forward<Arg>(f)));
+        ops_ = HeapOps<F>::ops();
+    }
+
+    void reset() {
+        if (ops_ != nullptr) {
+            ops_->destroy(&storage_);
+            ops_ = nullptr;
+        }
+    }
+
+    mutable Storage storage_; /* 内置缓冲区 */
+    const Ops* ops_;          /* 为空表示没有可调用对象 */
+};
+
+
+#endif // __TASK_HH_
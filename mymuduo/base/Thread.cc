@@ -1,7 +1,10 @@
 #include "Thread.hh"
 #include "CurrentThread.hh"
+#include "Logger.hh"
 
 #include <semaphore.h>
+#include <pthread.h>
+#include <sched.h>
 
 /* atomic_int32_t禁止使用拷贝构造 不能使用= */
 std::atomic_int32_t Thread::numCreated_{0};
@@ -31,6 +34,8 @@ void Thread::start() {
         new std::thread([&](){
             /* 获取线程id */
             tid_ = CurrentThread::tid();
+            /* 先绑定CPU 线程函数中分配的内存都在绑定之后首次写入 */
+            applyCpuAffinity();
             /* 获取完tid后可以通知start()返回 */
             sem_post(&sem);
             /* 新线程执行的函数 */
@@ -46,6 +51,24 @@ void Thread::join() {
     thread_->join();
 }
 
+void Thread::applyCpuAffinity() {
+    if (cpus_.empty()) {
+        return;
+    }
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    for (int cpu : cpus_) {
+        if (cpu >= 0 && cpu < CPU_SETSIZE) {
+            CPU_SET(cpu, &cpuset);
+        }
+    }
+    int ret = ::pthread_setaffinity_np(::pthread_self(), sizeof(cpuset), &cpuset);
+    if (ret != 0) {
+        /* 绑定失败不影响运行 由调度器决定线程在哪个CPU上运行 */
+        LOG_ERROR("Thread %s pthread_setaffinity_np error:%d \n", name_.c_str(), ret);
+    }
+}
+
 /* 线程的默认名字使用线程创建的序号 */
 void Thread::setDefaultName() {
     int num = ++ numCreated_;
@@ -9,6 +9,7 @@
 #include <unistd.h>
 #include <string>
 #include <atomic>
+#include <vector>
 
 /* Thread线程类 记录一个新线程的详细信息 */
 class Thread : noncopyable {
@@ -19,6 +20,13 @@ public:
     explicit Thread(ThreadFunc func, const std::string& name = std::string());
     ~Thread();
 
+    /*
+        把线程绑定到cpus中的CPU上 需要在start之前设置 为空表示不绑定
+        在新线程执行func之前绑定 线程中首次写入的内存由内核分配在该CPU所在的NUMA节点上
+    */
+    void setCpuAffinity(const std::vector<int>& cpus) { cpus_ = cpus; }
+    const std::vector<int>& cpuAffinity() const { return cpus_; }
+
     void start();
     void join();
 
@@ -29,6 +37,8 @@ public:
     static int32_t numCreated() { return numCreated_; }
 private:
     void setDefaultName();
+    /* 在新线程中调用 绑定CPU */
+    void applyCpuAffinity();
 
     bool started_;
     bool joined_;
@@ -36,6 +46,7 @@ private:
     pid_t tid_;
     ThreadFunc func_;
     std::string name_;
+    std::vector<int> cpus_; /* 绑定的CPU */
 
     static std::atomic_int32_t numCreated_;
 };
@@ -1,7 +1,11 @@
 #include "Timestamp.hh"
 
-#include <chrono>
-    
+#include <time.h>
+#include <stdio.h>
+#include <string.h>
+
+const int Timestamp::kMicroSecondsPerSecond; /* 静态常量要在类外定义 */
+
 /* 构造 */
 Timestamp::Timestamp() : microSecondsSinceEpoch_(0) {}
 Timestamp::Timestamp(int64_t microSecondsSinceEpoch) 
@@ -9,29 +13,64 @@ Timestamp::Timestamp(int64_t microSecondsSinceEpoch)
 
 /* 获得当前时间戳 从1970.01.01:00:00:00开始到现在的微秒数 */
 Timestamp Timestamp::now() {
-    /* 使用c++11 chrono库来获取时间戳 */
-    using namespace std::chrono;
-    auto time_now = system_clock::now();
-    auto duration_in_us = duration_cast<microseconds>(time_now.time_since_epoch());
-    return Timestamp(duration_in_us.count());
+    struct timespec ts;
+    ::clock_gettime(CLOCK_REALTIME, &ts);
+    return Timestamp(static_cast<int64_t>(ts.tv_sec) * kMicroSecondsPerSecond + ts.tv_nsec / 1000);
+}
+
+/* 单调时钟的当前时间 从系统启动开始的微秒数 */
+Timestamp Timestamp::monotonicNow() {
+    struct timespec ts;
+    ::clock_gettime(CLOCK_MONOTONIC, &ts);
+    return Timestamp(static_cast<int64_t>(ts.tv_sec) * kMicroSecondsPerSecond + ts.tv_nsec / 1000);
 }
 
+/* 每个线程缓存上一次格式化的秒 以及格式化好的前缀 "yyyy/mm/dd hh:mm:ss seconds." */
+static __thread int64_t t_cachedSeconds = -1;
+static __thread char t_cachedPrefix[64];
+static __thread size_t t_cachedPrefixLen = 0;
+
 /* 时间戳转字符串 */
 std::string Timestamp::toString() const {
-    char buf[128] = {0};
-    int64_t seconds = microSecondsSinceEpoch_ / 1000000;
-    int64_t microseconds = microSecondsSinceEpoch_ % 1000000;
-    time_t seconds_since_epoch = static_cast<time_t>(seconds);
-    std::tm tm_time = *std::localtime(&seconds_since_epoch);
-    /* 格式化输出时间戳 yyyy/mm/dd hh:mm:ss s.us*/
-    snprintf(buf, sizeof(buf), "%4d/%02d/%02d %02d:%02d:%02d %jd.%06jd", 
-        tm_time.tm_year + 1900,
-        tm_time.tm_mon + 1,
-        tm_time.tm_mday,
-        tm_time.tm_hour,
-        tm_time.tm_min,
-        tm_time.tm_sec,
-        seconds,
-        microseconds);
-    return buf;
+    char buf[128];
+    size_t len = formatTo(buf, sizeof(buf));
+    return std::string(buf, len);
+}
+
+/* 格式化到buf中 格式 yyyy/mm/dd hh:mm:ss s.us */
+size_t Timestamp::formatTo(char* buf, size_t size) const {
+    int64_t seconds = microSecondsSinceEpoch_ / kMicroSecondsPerSecond;
+    int64_t microseconds = microSecondsSinceEpoch_ % kMicroSecondsPerSecond;
+    if (seconds != t_cachedSeconds) {
+        /* 进入新的一秒 重新格式化前缀 */
+        time_t seconds_since_epoch = static_cast<time_t>(seconds);
+        struct tm tm_time;
+        ::localtime_r(&seconds_since_epoch, &tm_time);
+        int n = snprintf(t_cachedPrefix, sizeof(t_cachedPrefix), "%4d/%02d/%02d %02d:%02d:%02d %jd.",
+            tm_time.tm_year + 1900,
+            tm_time.tm_mon + 1,
+            tm_time.tm_mday,
+            tm_time.tm_hour,
+            tm_time.tm_min,
+            tm_time.tm_sec,
+            static_cast<intmax_t>(seconds));
+        t_cachedPrefixLen = n > 0 ? static_cast<size_t>(n) : 0;
+        t_cachedSeconds = seconds;
+    }
+    if (size < t_cachedPrefixLen + 7) {
+        /* 放不下 */
+        if (size > 0) {
+            buf[0] = '\0';
+        }
+        return 0;
+    }
+    memcpy(buf, t_cachedPrefix, t_cachedPrefixLen);
+    /* 只改写6位微秒数 */
+    char* p = buf + t_cachedPrefixLen + 6;
+    *p = '\0';
+    for (int i = 0; i < 6; ++ i) {
+        *--p = static_cast<char>('0' + microseconds % 10);
+        microseconds /= 10;
+    }
+    return t_cachedPrefixLen + 6;
 }
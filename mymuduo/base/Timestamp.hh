@@ -3,6 +3,7 @@
 
 #include <iostream>
 #include <string>
+#include <stdint.h>
 
 
 /* 时间戳类 */
@@ -11,14 +12,50 @@ public:
     /* 构造 */
     Timestamp();
     explicit Timestamp(int64_t microSecondsSinceEpoch);
-    /* 获得当前时间戳 */
+    /* 获得当前时间戳 墙上时间 会随系统时间的调整而跳变 */
     static Timestamp now();
+    /* 单调时钟的当前时间 从系统启动开始计时 只能用于计算时间间隔 不能转成日期 */
+    static Timestamp monotonicNow();
+    /* 无效的时间戳 */
+    static Timestamp invalid() { return Timestamp(); }
     /* 时间戳转字符串 */
     std::string toString() const;
+    /*
+        格式化到buf中 返回写入的长度(不含结尾的0) 格式和toString相同
+        每个线程缓存上一次格式化的秒 同一秒内只改写微秒部分 不调用localtime和snprintf
+    */
+    size_t formatTo(char* buf, size_t size) const;
+
+    /* 时间戳是否有效 */
+    bool valid() const { return microSecondsSinceEpoch_ > 0; }
+    /* 获得微秒数 */
+    int64_t microSecondsSinceEpoch() const { return microSecondsSinceEpoch_; }
+
+    static const int kMicroSecondsPerSecond = 1000 * 1000;
 private:
     /* 微秒数时间戳 */
     int64_t microSecondsSinceEpoch_;
 };
 
+/* 时间戳比较 定时器按到期时间排序时使用 */
+inline bool operator<(Timestamp lhs, Timestamp rhs) {
+    return lhs.microSecondsSinceEpoch() < rhs.microSecondsSinceEpoch();
+}
+inline bool operator==(Timestamp lhs, Timestamp rhs) {
+    return lhs.microSecondsSinceEpoch() == rhs.microSecondsSinceEpoch();
+}
+
+/* 两个时间戳相差的秒数 high - low */
+inline double timeDifference(Timestamp high, Timestamp low) {
+    int64_t diff = high.microSecondsSinceEpoch() - low.microSecondsSinceEpoch();
+    return static_cast<double>(diff) / Timestamp::kMicroSecondsPerSecond;
+}
+
+/* 在时间戳上增加seconds秒 */
+inline Timestamp addTime(Timestamp timestamp, double seconds) {
+    int64_t delta = static_cast<int64_t>(seconds * Timestamp::kMicroSecondsPerSecond);
+    return Timestamp(timestamp.microSecondsSinceEpoch() + delta);
+}
+
 
-#endif // __TIMESTAMP_HH_
\ No newline at end of file
+#endif // __TIMESTAMP_HH_
@@ -6,6 +6,8 @@
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
 
 
 static int createNonblocking() {
@@ -23,6 +25,9 @@ Acceptor::Acceptor(EventLoop* loop, const InetAddress& listenAddr, bool reusepor
     , acceptSocket_(createNonblocking())
     , acceptChannel_(loop, acceptSocket_.fd())
     , listenning_(false)
+    , backlog_(1024)
+    , maxAcceptsPerRead_(16)
+    , idleFd_(::open("/dev/null", O_RDONLY | O_CLOEXEC))
     {
         acceptSocket_.setReuseAddr(true);
         acceptSocket_.setReusePort(reuseport);
@@ -35,31 +40,66 @@ Acceptor::~Acceptor() {
     /* baseloop不再监听新用户连接 */
     acceptChannel_.disableAll();
     acceptChannel_.remove();
+    if (idleFd_ >= 0) {
+        ::close(idleFd_);
+    }
 }
 
 void Acceptor::listen() {
     listenning_ = true;
-    acceptSocket_.listen(); /* listen */
+    acceptSocket_.listen(backlog_); /* listen */
     acceptChannel_.enableReading(); /* 注册到baseloop */
 }
 
-/* acceptChannel_收到新用户连接事件时 调用该函数 */
+/*
+    acceptChannel_收到新用户连接事件时 调用该函数
+    一次最多accept maxAcceptsPerRead_个连接 大量连接同时到来时不必每个连接都经过一次epoll_wait
+    也不会因为一直accept而耽误loop上的其他事件
+*/
 void Acceptor::handleRead() {
-    InetAddress peerAddr;
-    int connfd = acceptSocket_.accept(&peerAddr); /* 和新用户建立连接 */
-    if (connfd >= 0) {
-        if (newConnectionCallback_) {
-            newConnectionCallback_(connfd, peerAddr);
-        } else {
-            /* 如果一个客户端连接了 但没有相应的回调去处理 就关闭连接 */
-            ::close(connfd);
+    for (int i = 0; i < maxAcceptsPerRead_; ++ i) {
+        InetAddress peerAddr;
+        int connfd = acceptSocket_.accept(&peerAddr); /* 和新用户建立连接 */
+        if (connfd >= 0) {
+            if (newConnectionCallback_) {
+                newConnectionCallback_(connfd, peerAddr);
+            } else {
+                /* 如果一个客户端连接了 但没有相应的回调去处理 就关闭连接 */
+                ::close(connfd);
+            }
+            continue;
+        }
+        int savedErrno = errno;
+        if (savedErrno == EAGAIN || savedErrno == EWOULDBLOCK) {
+            /* 已完成连接队列已经取空 */
+            break;
+        }
+        if (savedErrno == EINTR || savedErrno == ECONNABORTED || savedErrno == EPROTO) {
+            /* 连接在accept之前被对端重置等 继续accept下一个 */
+            continue;
         }
-    } else {
         /* accept出错了 */
-        LOG_ERROR("Acceptor::handleRead accept error:%d \n", errno);
-        if (errno == EMFILE) {
-            /* 该进程fd资源用尽 */
-            LOG_ERROR("sockfd reached limited \n");
+        LOG_ERROR("Acceptor::handleRead accept error:%d \n", savedErrno);
+        if (savedErrno == EMFILE || savedErrno == ENFILE) {
+            if (idleFd_ < 0) {
+                /* 上次重新打开空闲fd失败了 现在再试一次 */
+                idleFd_ = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+            }
+            if (idleFd_ >= 0) {
+                /* 该进程fd资源用尽 腾出空闲fd 接受并立即关闭这个连接 拒绝对端 */
+                LOG_ERROR("sockfd reached limited, shedding connection \n");
+                ::close(idleFd_);
+                int connfd = ::accept(acceptSocket_.fd(), nullptr, nullptr);
+                if (connfd >= 0) {
+                    ::close(connfd);
+                }
+                idleFd_ = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+                if (idleFd_ < 0) {
+                    LOG_ERROR("Acceptor::handleRead reopen idle fd error:%d \n", errno);
+                }
+                continue;
+            }
         }
+        break;
     }
-}
\ No newline at end of file
+}
@@ -20,6 +20,10 @@ public:
     void setNewConnectionCallback(const NewConnectionCallback& cb) {
         newConnectionCallback_ = cb;
     }
+    /* listen的backlog 默认1024 需要在listen之前设置 */
+    void setBacklog(int backlog) { backlog_ = backlog; }
+    /* 每次可读事件最多accept多少个连接 默认16 最少为1 否则listenfd一直可读 loop会空转 */
+    void setMaxAcceptsPerRead(int maxAccepts) { maxAcceptsPerRead_ = maxAccepts > 0 ? maxAccepts : 1; }
     bool listenning() const { return listenning_; }
     void listen();
 
@@ -27,13 +31,22 @@ private:
     /* acceptChannel_收到新用户连接事件时 调用该函数 */
     void handleRead();
 
-    EventLoop* loop_; /* 就是mainloop */
+    EventLoop* loop_; /* 一般是mainloop TcpServer::kReusePortPerLoop时是各个subloop */
     Socket acceptSocket_;
     Channel acceptChannel_;
     NewConnectionCallback newConnectionCallback_; /* 新用户连接时执行回调 将connfd打包为Channel 唤醒一个subloop处理connfd读写事件 */
     /* 该函数由TcpServer给出 */
 
     bool listenning_;
+    int backlog_;
+    int maxAcceptsPerRead_;
+    /*
+        预留的空闲fd 进程的fd用尽(EMFILE)时 关闭它腾出一个fd
+        accept那个无法处理的连接并立即关闭 再重新打开空闲fd
+        否则连接一直留在队列中 listenfd一直可读 loop会空转
+        重新打开失败时为-1 下次EMFILE时再尝试打开
+    */
+    int idleFd_;
 
 };
 
@@ -25,6 +25,9 @@
     Buffer使用方法: writable区紧跟着readable区 先写再读 写入的数据直接进入可读区
                    可写区写入字符后 writerIndex后移(可读区扩大)
                    写入的字符就直接进入可读区的末尾了 可以被读取了
+
+    底层数组在第一次写入时才分配 没有数据时可以用release()释放
+    大量空闲连接的Buffer不占用内存
 */
 
 class Buffer {
@@ -33,17 +36,43 @@ public:
     static const size_t kCheapPrepend = 8;      /* 预留区最小长度 */
     static const size_t kInitialSize = 1024;    /* 缓冲区初始大小 */
 
+    /* 构造时不分配内存 第一次写入时分配kCheapPrepend + max(initialSize, 写入长度) */
     explicit Buffer(size_t initialSize = kInitialSize) 
-        : buffer_(kCheapPrepend + initialSize)
+        : initialSize_(initialSize)
         , readerIndex_(kCheapPrepend)
         , writerIndex_(kCheapPrepend)
         {
     }
     ~Buffer() = default;
 
+    /* 交换两个Buffer的内容 不拷贝数据 */
+    void swap(Buffer& rhs) {
+        buffer_.swap(rhs.buffer_);
+        std::swap(initialSize_, rhs.initialSize_);
+        std::swap(readerIndex_, rhs.readerIndex_);
+        std::swap(writerIndex_, rhs.writerIndex_);
+    }
+
     size_t readableBytes() const { return writerIndex_ - readerIndex_; }   /* 可读数据长度 */
-    size_t writableBytes() const { return buffer_.size() - writerIndex_; } /* 可写缓冲区长度 */
+    size_t writableBytes() const {                                          /* 可写缓冲区长度 */
+        return buffer_.empty() ? 0 : buffer_.size() - writerIndex_;
+    }
     size_t prependableBytes() const { return readerIndex_; }               /* 预留区长度(最小8) */
+    size_t capacity() const { return buffer_.capacity(); }                 /* 底层数组占用的内存 */
+
+    /*
+        没有可读数据时释放底层数组 返回是否释放了内存
+        下次写入时重新按initialSize分配 用于突发流量之后收缩 以及空闲连接归还内存
+    */
+    bool release() {
+        if (readableBytes() > 0 || buffer_.capacity() == 0) {
+            return false;
+        }
+        std::vector<char>().swap(buffer_);
+        readerIndex_ = kCheapPrepend;
+        writerIndex_ = kCheapPrepend;
+        return true;
+    }
 
     const char* peek() const { return begin() + readerIndex_; } /* 获得可读数据首地址 */
 
@@ -96,15 +125,23 @@ public:
 
 
 /* 读写文件描述符 */
-    /* 从fd读取数据到Buffer */
+    /* 从fd读取数据到Buffer 可写空间不够时先读到栈上的64K空间中 */
     ssize_t readFd(int fd, int* savedErrno);
+    /* 同上 使用调用者提供的extrabuf(如EventLoop的接收缓冲区) 一次最多读writableBytes() + extrabufSize */
+    ssize_t readFd(int fd, int* savedErrno, char* extrabuf, size_t extrabufSize);
     /* 从Buffer写数据到fd */
     ssize_t writeFd(int fd, int* savedErrno);
 
 private:
     /* 获得Buffer底层数组首地址 对socket进行操作需要字符串指针 从vector底层数组获取 */
-    char* begin() { return &*buffer_.begin(); } /* it.operator*()获得char再&获得地址 */
-    const char* begin() const { return &*buffer_.begin(); }
+    /* 还没有分配时指向静态的空数组 peek() beginWrite()仍然是合法的指针 此时可读可写长度都为0 */
+    char* begin() { return buffer_.empty() ? emptyArray() : buffer_.data(); }
+    const char* begin() const { return buffer_.empty() ? emptyArray() : buffer_.data(); }
+    /* 没有分配时readerIndex_ writerIndex_都是kCheapPrepend 指向该数组的末尾 不会读写其中的内容 */
+    static char* emptyArray() {
+        static char empty[kCheapPrepend];
+        return empty;
+    }
     
 
     /* 对底层数组空间进行扩容或重新调整 满足可写区有len长度的空间 */
@@ -114,7 +151,10 @@ private:
             只需把可读区向前移动即可在数组后面留出足够的空间
             否则必须进行扩容
         */
-        if (writableBytes() + prependableBytes() < len + kCheapPrepend) {
+        if (buffer_.empty()) {
+            /* 第一次写入 或者release之后再次写入 */
+            buffer_.resize(kCheapPrepend + std::max(len, initialSize_));
+        } else if (writableBytes() + prependableBytes() < len + kCheapPrepend) {
             /* 空间不足 需要扩容 */
             buffer_.resize(writerIndex_ + len); /* 保证writableBytes()有len长度 */
         } else {
@@ -129,6 +169,7 @@ private:
     }
 
     std::vector<char> buffer_; /* 缓冲区数组 */
+    size_t initialSize_;       /* 第一次分配时的可写区大小 */
     size_t readerIndex_;       /* 可读起始位置 */
     size_t writerIndex_;        /* 可写起始位置 */
 
@@ -0,0 +1,165 @@
+#include "ChainBuffer.hh"
+
+#include <sys/uio.h>
+#include <sys/sendfile.h>
+#include <unistd.h>
+#include <limits.h>
+#include <errno.h>
+#include <string.h>
+#include <algorithm>
+
+const size_t ChainBuffer::kBlockSize; /* 静态常量要在类外定义 */
+const size_t ChainBuffer::kMinSharedSize;
+
+ChainBuffer::ChainBuffer()
+    : head_(0)
+    , readableBytes_(0)
+    {
+}
+
+ChainBuffer::~ChainBuffer() = default;
+
+
+/* 拷贝data上len长度的数据 先填满最后一个block 不够再分配新的block */
+void ChainBuffer::append(const char* data, size_t len) {
+    while (len > 0) {
+        if (head_ == segments_.size() || !segments_.back().block || segments_.back().writable() == 0) {
+            /* 没有可写的block 在尾部分配一个 */
+            segments_.emplace_back();
+            Segment& seg = segments_.back();
+            seg.block.reset(new char[kBlockSize]);
+            seg.data = seg.block.get();
+            seg.capacity = kBlockSize;
+        }
+        Segment& seg = segments_.back();
+        size_t n = std::min(len, seg.writable());
+        memcpy(seg.block.get() + seg.writeIndex, data, n);
+        seg.writeIndex += n;
+        readableBytes_ += n;
+        data += n;
+        len -= n;
+    }
+}
+
+/* 引用owner管理的内存 不拷贝 */
+void ChainBuffer::appendShared(std::shared_ptr<const void> owner, const char* data, size_t len) {
+    if (len < kMinSharedSize) {
+        append(data, len);
+        return;
+    }
+    segments_.emplace_back();
+    Segment& seg = segments_.back();
+    seg.data = data;
+    seg.writeIndex = len;
+    seg.capacity = len;
+    seg.owner = std::move(owner);
+    readableBytes_ += len;
+}
+
+/* 文件fd中的一段 sendfile发送 */
+void ChainBuffer::appendFile(int fd, off_t offset, size_t len) {
+    segments_.emplace_back();
+    Segment& seg = segments_.back();
+    seg.writeIndex = len;
+    seg.capacity = len;
+    seg.fd = fd;
+    seg.fileOffset = offset;
+    /* 段释放时关闭fd */
+    seg.owner = std::shared_ptr<const void>(nullptr, [fd](const void*) { ::close(fd); });
+    readableBytes_ += len;
+}
+
+/* 删除开头len长度已经发送的数据 */
+void ChainBuffer::retrieve(size_t len) {
+    if (len >= readableBytes_) {
+        retrieveAll();
+        return;
+    }
+    readableBytes_ -= len;
+    while (len > 0) {
+        Segment& seg = segments_[head_];
+        size_t n = std::min(len, seg.readable());
+        seg.readIndex += n;
+        len -= n;
+        if (seg.readable() == 0 && (seg.writable() == 0 || head_ + 1 < segments_.size())) {
+            /* 这个段已经发送完 且不会再写入(只有最后一个block会被写入) */
+            popFront();
+        }
+    }
+}
+
+/* 删除全部数据 */
+void ChainBuffer::retrieveAll() {
+    segments_.clear();
+    head_ = 0;
+    readableBytes_ = 0;
+}
+
+bool ChainBuffer::release() {
+    if (!empty() || segments_.capacity() == 0) {
+        return false;
+    }
+    std::vector<Segment>().swap(segments_);
+    head_ = 0;
+    return true;
+}
+
+/* 释放已经发送完的段 */
+void ChainBuffer::popFront() {
+    Segment& seg = segments_[head_];
+    seg.block.reset();
+    seg.owner.reset();
+    ++ head_;
+    if (head_ == segments_.size()) {
+        segments_.clear();
+        head_ = 0;
+    } else if (head_ > segments_.size() / 2) {
+        /* 前面的空位超过一半 整体前移 均摊O(1) */
+        segments_.erase(segments_.begin(), segments_.begin() + head_);
+        head_ = 0;
+    }
+}
+
+/* 用writev把缓冲区中的数据写到fd */
+ssize_t ChainBuffer::writeFd(int fd, int* savedErrno) const {
+    /* 跳过开头已经读完的block */
+    size_t first = head_;
+    while (first < segments_.size() && segments_[first].readable() == 0) {
+        ++ first;
+    }
+    if (first < segments_.size() && segments_[first].isFile()) {
+        const Segment& seg = segments_[first];
+        off_t offset = seg.fileOffset + static_cast<off_t>(seg.readIndex);
+        /* sendfile一次最多发送0x7ffff000字节 */
+        size_t count = std::min(seg.readable(), static_cast<size_t>(0x7ffff000));
+        ssize_t n = ::sendfile(fd, seg.fd, &offset, count);
+        if (n < 0) {
+            *savedErrno = errno;
+        } else if (n == 0) {
+            /* 文件已经读到末尾 剩下的数据永远发不出去 */
+            *savedErrno = EIO;
+            n = -1;
+        }
+        return n;
+    }
+    /* 一次writev最多IOV_MAX个段 到file段为止 */
+    struct iovec vec[IOV_MAX];
+    int iovcnt = 0;
+    for (size_t i = first; i < segments_.size() && iovcnt < IOV_MAX; ++ i) {
+        const Segment& seg = segments_[i];
+        if (seg.isFile()) {
+            break;
+        }
+        if (seg.readable() == 0) {
+            continue;
+        }
+        vec[iovcnt].iov_base = const_cast<char*>(seg.readBegin());
+        vec[iovcnt].iov_len = seg.readable();
+        ++ iovcnt;
+    }
+    ssize_t n = ::writev(fd, vec, iovcnt);
+    if (n < 0) {
+        *savedErrno = errno;
+    }
+    return n;
+}
@@ -0,0 +1,102 @@
+#ifndef   __CHAINBUFFER_HH_
+#define   __CHAINBUFFER_HH_
+
+#include "../base/noncopyable.hh"
+
+#include <vector>
+#include <memory>
+#include <sys/types.h>
+#include <stddef.h>
+
+/*
+                                ChainBuffer
+    +-----------+      +-----------+      +-----------------+      +-----------+
+    | block 16K | ---> | block 16K | ---> | shared memory   | ---> | block 16K |
+    +-----------+      +-----------+      +-----------------+      +-----------+
+      head_                                 (引用 不拷贝)             tail
+
+    ChainBuffer 分段的发送缓冲区 由一串段(Segment)组成 用作TcpConnection的outputBuffer_
+    每个段是以下三种之一:
+        block:  缓冲区自己分配的固定大小(kBlockSize)的内存块 append拷贝的数据写入最后一个block
+        shared: 引用外部的内存 由shared_ptr管理生命周期 数据不拷贝 发送完成后释放引用
+        file:   文件fd中的一段 用sendfile发送 数据不经过用户态 发送完成后关闭fd
+
+    和Buffer相比:
+        追加数据时只会在尾部分配新的block 不会扩容搬移已有的数据 积压几十MB也不会有O(n)的realloc
+        发送时用writev 一次系统调用最多发送IOV_MAX个段 遇到file段时单独用sendfile发送
+        已经发送的段直接释放 不需要memmove
+*/
+class ChainBuffer : noncopyable {
+public:
+    static const size_t kBlockSize = 16 * 1024; /* block的大小 */
+    static const size_t kMinSharedSize = 512;   /* 比这更小的shared数据直接拷贝 单独占一个段不划算 */
+
+    ChainBuffer();
+    ~ChainBuffer();
+
+    /* 待发送的数据长度 */
+    size_t readableBytes() const { return readableBytes_; }
+    bool empty() const { return readableBytes_ == 0; }
+
+    /* 拷贝data上len长度的数据 先填满最后一个block 不够再分配新的block */
+    void append(const char* data, size_t len);
+    /*
+        引用owner管理的内存[data, data + len) 不拷贝
+        owner可以是shared_ptr<std::string>等 也可以是带自定义删除器的调用者的内存
+        数据发送完成或者缓冲区销毁时释放owner
+        len小于kMinSharedSize时拷贝到block中 立即释放owner
+    */
+    void appendShared(std::shared_ptr<const void> owner, const char* data, size_t len);
+    /*
+        文件fd中[offset, offset + len)的内容 发送时用sendfile 不读入内存
+        接管fd 发送完成或者缓冲区销毁时关闭fd
+    */
+    void appendFile(int fd, off_t offset, size_t len);
+
+    /* 删除开头len长度已经发送的数据 */
+    void retrieve(size_t len);
+    /* 删除全部数据 */
+    void retrieveAll();
+    /* 没有待发数据时释放所有内存(包括段数组) 返回是否释放了内存 */
+    bool release();
+
+    /*
+        用writev把缓冲区中的数据写到fd 不删除数据 需要调用retrieve
+        开头是file段时用sendfile发送该段 文件比预期的短时返回-1 savedErrno为EIO
+    */
+    ssize_t writeFd(int fd, int* savedErrno) const;
+
+private:
+    struct Segment {
+        Segment() : data(nullptr), readIndex(0), writeIndex(0), capacity(0), fd(-1), fileOffset(0) {}
+        /* 可读数据 和 block中剩余的可写空间 */
+        const char* readBegin() const { return data + readIndex; }
+        size_t readable() const { return writeIndex - readIndex; }
+        size_t writable() const { return capacity - writeIndex; }
+        bool isFile() const { return fd >= 0; }
+
+        const char* data;                   /* 段的内存首地址 */
+        size_t readIndex;                   /* 可读起始位置 */
+        size_t writeIndex;                  /* 可写起始位置 shared段等于capacity */
+        size_t capacity;
+        std::unique_ptr<char[]> block;      /* block段持有的内存 */
+        std::shared_ptr<const void> owner;  /* shared段引用的内存的所有者 file段负责关闭fd */
+        int fd;                             /* file段的文件fd 其他段为-1 */
+        off_t fileOffset;                   /* file段在文件中的起始位置 已发送readIndex字节 */
+    };
+
+    /* 释放已经发送完的段 */
+    void popFront();
+
+    /*
+        [head_, segments_.size())为有效的段
+        不用std::deque 空的deque也会分配内存 而空的vector不会
+        前面的空位在超过一半时才整体前移
+    */
+    std::vector<Segment> segments_;
+    size_t head_;
+    size_t readableBytes_;
+};
+
+
+#endif // __CHAINBUFFER_HH_
@@ -7,10 +7,11 @@
 const int Channel::kNoneEvent = 0;                   /* 没有事件 */
 const int Channel::kReadEvent = EPOLLIN | EPOLLPRI;  /* 读事件 */
 const int Channel::kWriteEvent = EPOLLOUT;           /* 写事件 */
+const int Channel::kEdgeTriggeredEvents = EPOLLIN | EPOLLPRI | EPOLLOUT | EPOLLRDHUP | EPOLLET;
 
 /* 构造和析构 */
 Channel::Channel(EventLoop* loop, int fd) 
-    : loop_(loop), fd_(fd), events_(0), revents_(0), index_(-1), tied_(false) {}
+    : loop_(loop), fd_(fd), events_(0), revents_(0), index_(-1), edgeTriggered_(false), tied_(false) {}
 Channel::~Channel() {
 
 }
@@ -22,6 +23,11 @@ void Channel::tie(const std::shared_ptr<void>& obj) {
     tied_ = true;
 }
 
+/* 边缘触发模式 Poller不支持时使用水平触发 一直读写到EAGAIN的用法在水平触发下同样正确 */
+void Channel::setEdgeTriggered(bool on) {
+    edgeTriggered_ = on && loop_->supportsEdgeTriggered();
+}
+
 /* 更新在poller上注册的事件 */
 void Channel::update() {
     /* 通过Channel所属的EventLoop 调用Poller的相应方法注册fd的events事件 */
@@ -63,7 +69,8 @@ void Channel::handleEventWithGuard(Timestamp receiveTime) {
             errorCallback_();
         }
     }
-    if (revents_ & (EPOLLIN | EPOLLPRI)) {
+    if (revents_ & (EPOLLIN | EPOLLPRI | EPOLLRDHUP)) {
+        /* EPOLLRDHUP只在边缘触发模式下注册 对端关闭 读到0后关闭连接 */
         /* 可读事件 */
         if (readCallback_) {
             readCallback_(receiveTime);
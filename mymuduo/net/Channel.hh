@@ -38,12 +38,26 @@ public:
     /* 设置poller返回的发生的事件 提供给Poller使用 */
     void set_revents(int revt) { revents_ = revt; }
     
+    /* 向poller注册的事件 边缘触发模式下只要关注了事件就固定注册读写事件 */
+    int pollEvents() const {
+        return (edgeTriggered_ && events_ != kNoneEvent) ? kEdgeTriggeredEvents : events_;
+    }
+
     /* 更新事件 */
-    void enableReading() { events_ |= kReadEvent; update(); } /* update epoll_ctl */
-    void disableReading() { events_ &= ~kReadEvent; update(); }
-    void enableWriting() { events_ |= kWriteEvent; update(); }
-    void disableWriting() { events_ &= ~kWriteEvent; update(); }
-    void disableAll() { events_ = kNoneEvent; update();}
+    void enableReading() { setEvents(events_ | kReadEvent); } /* update epoll_ctl */
+    void disableReading() { setEvents(events_ & ~kReadEvent); }
+    void enableWriting() { setEvents(events_ | kWriteEvent); }
+    void disableWriting() { setEvents(events_ & ~kWriteEvent); }
+    void disableAll() { setEvents(kNoneEvent); }
+
+    /* 
+        边缘触发模式 必须在注册事件之前设置
+        fd以EPOLLIN|EPOLLOUT|EPOLLRDHUP|EPOLLET注册一次 之后enableWriting/disableWriting只改变events_
+        不再调用epoll_ctl 使用者需要一直读写到EAGAIN
+        loop的Poller不支持边缘触发(io_uring)时忽略 仍然使用水平触发
+    */
+    void setEdgeTriggered(bool on);
+    bool isEdgeTriggered() const { return edgeTriggered_; }
 
     /* 当前的事件状态 */
     bool isReading () const { return events_ & kReadEvent; }
@@ -62,6 +76,14 @@ public:
 private:
     /* 更新在poller上注册的事件 */
     void update();
+    /* 修改关注的事件 只有注册到poller上的事件改变时才需要update */
+    void setEvents(int events) {
+        int oldPollEvents = pollEvents();
+        events_ = events;
+        if (!edgeTriggered_ || pollEvents() != oldPollEvents) {
+            update();
+        }
+    }
 
     /* 受保护的handleEvent  由handleEvent调用 */
     void handleEventWithGuard(Timestamp receiveTime);
@@ -71,12 +93,14 @@ private:
     static const int kNoneEvent;  /* 没有事件 */
     static const int kReadEvent;  /* 读事件 */
     static const int kWriteEvent; /* 写事件 */
+    static const int kEdgeTriggeredEvents; /* 边缘触发模式下注册的事件 */
 
     EventLoop* loop_;   /* 事件循环 */
     const int fd_;      /* fd poller监听的对象 */
     int events_;        /* 注册fd感兴趣的事件 */
     int revents_;       /* poller返回的具体发生的事件 */
     int index_; /* 表示该Channel在Poller中的状态 -1 1 2 */
+    bool edgeTriggered_; /* 是否使用边缘触发模式 */
 
     std::weak_ptr<void> tie_;
     bool tied_;
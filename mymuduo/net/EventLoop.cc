@@ -2,6 +2,8 @@
 #include "../base/Logger.hh"
 #include "Poller.hh"
 #include "Channel.hh"
+#include "TimerQueue.hh"
+#include "Buffer.hh"
 
 #include <sys/eventfd.h>
 #include <unistd.h>
@@ -15,6 +17,12 @@ __thread EventLoop* t_loopInThisThread = nullptr;
 /* 定义默认的Poller的IO复用接口的超时事件 */
 const int kPollTimeMs = 10000;
 
+/* loop共用的接收缓冲区的大小 一次read最多读这么多 */
+const size_t kReceiveBufferSize = 64 * 1024;
+
+/* 统计处理事件时间的窗口长度 */
+const int64_t kBusyWindowMicros = Timestamp::kMicroSecondsPerSecond;
+
 /* 创建wakeupfd 用来唤醒subReactor处理新来的channel */
 int createEventfd() {
     int evtfd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
@@ -30,10 +38,21 @@ EventLoop::EventLoop()
     : looping_(false)
     , quit_(false)
     , threadId_(CurrentThread::tid())
+    , slabPool_(std::make_shared<SlabPool>(threadId_))
+    , receiveBufferInUse_(false)
     , poller_(Poller::newDefaultPoller(this))
+    , timerQueue_(new TimerQueue(this))
     , wakeupFd_(createEventfd())
     , wakeupChannel_(new Channel(this, wakeupFd_))
+    , wakeupPending_(false)
+    , wakeupsWritten_(0)
+    , wakeupsElided_(0)
     , callingPendingFunctors_(false)
+    , callingAfterEventsFunctors_(false)
+    , connectionCount_(0)
+    , busyWindowStart_(0)
+    , busyInWindow_(0)
+    , busyLastWindow_(0)
     {
         LOG_DEBUG("EventLoop created %p in thread %d \n", this, threadId_);
         if (t_loopInThisThread != nullptr) {
@@ -77,13 +96,19 @@ void EventLoop::loop() {
     while (quit_ == false) {
         activeChannels_.clear();
         /* 获得发生事件的Channel */
-        pollReturnTime_ = poller_->poll(kPollTimeMs, &activeChannels_);
+        poller_->poll(kPollTimeMs, &activeChannels_);
+        /* 每轮循环只读取一次时钟 */
+        pollReturnTime_ = Timestamp::now();
+        monotonicNow_ = Timestamp::monotonicNow();
         /* 遍历所有发生事件的Channel 执行对应的回调 */
         for (Channel* channel : activeChannels_) {
             channel->handleEvent(pollReturnTime_);
         }
         /* 执行当前EventLoop事件循环需要处理的回调操作 */
         doPendingFunctors();
+        /* 本轮循环最后 执行合并后的操作 如cork模式下的发送 */
+        doAfterEventsFunctors();
+        recordBusyTime();
         /*
             IO线程 mainloop 主要做accept的工作 fd->Channel => subloop
             1. 如果我们的服务器只使用一个线程 就是mainloop
@@ -100,6 +125,48 @@ void EventLoop::loop() {
     looping_ = false;
 }
 
+/* 从poll返回到本轮循环结束的时间 计入当前窗口 窗口到期时滚动 */
+void EventLoop::recordBusyTime() {
+    int64_t now = Timestamp::monotonicNow().microSecondsSinceEpoch();
+    int64_t busy = now - monotonicNow_.microSecondsSinceEpoch();
+    int64_t start = busyWindowStart_.load(std::memory_order_relaxed);
+    if (now - start >= kBusyWindowMicros) {
+        /* 超过两个窗口没有滚动 说明中间一直空闲 上一个窗口为0 */
+        int64_t last = now - start >= 2 * kBusyWindowMicros ? 0 : busyInWindow_.load(std::memory_order_relaxed);
+        busyLastWindow_.store(last, std::memory_order_relaxed);
+        busyInWindow_.store(busy, std::memory_order_relaxed);
+        busyWindowStart_.store(now, std::memory_order_relaxed);
+    } else {
+        busyInWindow_.store(busyInWindow_.load(std::memory_order_relaxed) + busy, std::memory_order_relaxed);
+    }
+}
+
+/* loop长时间阻塞在poll中时窗口不会滚动 读取时按当前时间判断窗口是否已经过期 */
+int64_t EventLoop::recentBusyMicros() const {
+    int64_t now = Timestamp::monotonicNow().microSecondsSinceEpoch();
+    int64_t elapsed = now - busyWindowStart_.load(std::memory_order_relaxed);
+    int64_t current = busyInWindow_.load(std::memory_order_relaxed);
+    if (elapsed >= 2 * kBusyWindowMicros) {
+        return 0;
+    } else if (elapsed >= kBusyWindowMicros) {
+        return current;
+    }
+    return current + busyLastWindow_.load(std::memory_order_relaxed);
+}
+
+Buffer* EventLoop::acquireReceiveBuffer() {
+    if (receiveBufferInUse_) {
+        return nullptr;
+    }
+    if (!receiveBuffer_) {
+        receiveBuffer_.reset(new Buffer(kReceiveBufferSize));
+    }
+    /* 第一次使用时分配 之后保持kReceiveBufferSize的可写空间 */
+    receiveBuffer_->ensureWritableBytes(kReceiveBufferSize);
+    receiveBufferInUse_ = true;
+    return receiveBuffer_.get();
+}
+
 /* 退出事件循环 */
 void EventLoop::quit() {
     quit_ = true;
@@ -122,20 +189,17 @@ void EventLoop::runInLoop(Functor cb) {
         cb();
     } else {
         /* 在非loop线程中执行cb 就需要唤醒loop所在线程执行cb */
-        queueInLoop(cb);
+        queueInLoop(std::move(cb));
     }
 
 }
 
 /* 把cb放入队列中 唤醒loop所在线程执行cb */
 void EventLoop::queueInLoop(Functor cb) {
-    /* cb放入pendingFunctors */
-    {
-        std::unique_lock<std::mutex> lock(mutex_);
-        pendingFunctors_.emplace_back(cb); /* push_back也可 */
-    }
+    /* cb放入pendingFunctors 无锁队列 不会和其他线程竞争互斥锁 */
+    pendingFunctors_.push(std::move(cb));
     /* 唤醒相应的需要执行cb的loop的线程 */
-    if (isInLoopThread() == false || callingPendingFunctors_ == true) { 
+    if (isInLoopThread() == false || callingPendingFunctors_ == true || callingAfterEventsFunctors_) { 
         /* 
             callingPendingFunctors_ == true 表示上一轮的doPendingFunctors正在执行
             执行完进入下一轮循环时 仍然有可能再次阻塞
@@ -145,10 +209,53 @@ void EventLoop::queueInLoop(Functor cb) {
     }
 }
 
+/* 在本轮循环的最后执行cb 只能在loop线程中调用 */
+void EventLoop::queueAfterEvents(Functor cb) {
+    afterEventsFunctors_.push_back(std::move(cb));
+}
+
+
+
+/* 在time时刻执行cb 墙上时间转换为单调时钟的时间 */
+TimerId EventLoop::runAt(Timestamp time, TimerCallback cb) {
+    double delay = timeDifference(time, Timestamp::now());
+    return runAfter(delay, std::move(cb));
+}
+
+/*
+    delay秒后执行cb
+    这里不使用缓存的monotonicNow_ 它是本轮poll返回的时间 使用它定时器会提前到期
+*/
+TimerId EventLoop::runAfter(double delay, TimerCallback cb) {
+    Timestamp time(addTime(Timestamp::monotonicNow(), delay));
+    return timerQueue_->addTimer(std::move(cb), time, 0.0);
+}
+
+/* 每interval秒执行一次cb */
+TimerId EventLoop::runEvery(double interval, TimerCallback cb) {
+    Timestamp time(addTime(Timestamp::monotonicNow(), interval));
+    return timerQueue_->addTimer(std::move(cb), time, interval);
+}
+
+/* 取消定时器 */
+void EventLoop::cancel(TimerId timerId) {
+    timerQueue_->cancel(timerId);
+}
 
 
 /* mainloop唤醒该subloop 唤醒该loop所在线程 */
 void EventLoop::wakeup() {
+    /*
+        一轮循环中只需要写一次eventfd
+        如果wakeupPending_已经为true 说明已经有线程写过eventfd 而loop还没有执行doPendingFunctors
+        loop一定会从poll中醒来并执行到doPendingFunctors 这次写操作可以省掉
+        doPendingFunctors在取回调之前清除wakeupPending_ 之后的wakeup会重新写eventfd
+    */
+    if (wakeupPending_.exchange(true)) {
+        wakeupsElided_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    wakeupsWritten_.fetch_add(1, std::memory_order_relaxed);
     /* 向该EventLoop的wakeupfd_写一个数据即可唤醒 */
     uint64_t one = 1;
     ssize_t n = write(wakeupFd_, &one, sizeof(one));
@@ -173,28 +280,59 @@ bool EventLoop::hasChannel(Channel* channel) {
     return poller_->hasChannel(channel);
 }
 
+uint64_t EventLoop::pollerCtlCalls() const {
+    return poller_->ctlCalls();
+}
+
+bool EventLoop::supportsEdgeTriggered() const {
+    return poller_->supportsEdgeTriggered();
+}
+
+uint64_t EventLoop::pollerSavedCtlCalls() const {
+    return poller_->savedCtlCalls();
+}
+
 /* 执行回调 */
 void EventLoop::doPendingFunctors() {
     /* 执行mainloop注册到该loop中的回调操作 */
 
     /*
-        注意 这里我们并不能直接对pendingFunctors_进行加锁并遍历执行
-        而是需要创建一个局部vector将pendingFunctors_置换出来 再遍历执行
-        这是因为
-            doPendingFunctors()函数执行可能需要较长时间
-            在执行过程中 如果mainloop又注册了新的回调 就会阻塞在互斥锁上
-            运行效率很低
-        这样做 即使该loop正在执行需要做的回调
-        也不妨碍mainloop继续向该loop注册新的回调
+        pendingFunctors_是无锁的MPSC队列 其他线程可以随时继续向该loop注册新的回调
+        这里先把队列中当前可见的回调成批取出到runningFunctors_中 再遍历执行
+        这样执行回调期间新注册的回调会留到下一轮循环执行(queueInLoop中会wakeup)
+        不会因为回调中不断注册新回调而一直停留在这里
     */
-    std::vector<Functor> functors;
     callingPendingFunctors_ = true;
-    {
-        std::unique_lock<std::mutex> lock(mutex_);
-        functors.swap(pendingFunctors_);
+    /*
+        先清除wakeupPending_再取回调 此后入队的回调会重新写eventfd
+        exchange读到了生产者写入的true 保证能看到生产者在wakeup之前入队的回调
+    */
+    wakeupPending_.exchange(false);
+    Functor functor;
+    while (pendingFunctors_.pop(&functor)) {
+        runningFunctors_.push_back(std::move(functor));
     }
-    for (const Functor& functor : functors) {
-        functor();
+    for (const Functor& f : runningFunctors_) {
+        f();
     }
+    runningFunctors_.clear();
     callingPendingFunctors_ = false;
+}
+
+/* 执行本轮循环最后的回调 */
+void EventLoop::doAfterEventsFunctors() {
+    /*
+        回调中可能再次注册 一直执行到没有为止
+        否则新注册的回调要等到下一次poll返回才能执行
+        这期间queueInLoop的回调也需要wakeup 同callingPendingFunctors_
+    */
+    callingAfterEventsFunctors_ = true;
+    while (!afterEventsFunctors_.empty()) {
+        runningAfterEventsFunctors_.swap(afterEventsFunctors_);
+        for (const Functor& f : runningAfterEventsFunctors_) {
+            f();
+        }
+        runningAfterEventsFunctors_.clear();
+    }
+    callingAfterEventsFunctors_ = false;
 }
\ No newline at end of file
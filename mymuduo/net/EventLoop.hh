@@ -4,21 +4,27 @@
 #include "../base/noncopyable.hh"
 #include "../base/Timestamp.hh"
 #include "../base/CurrentThread.hh"
+#include "../base/MpscQueue.hh"
+#include "../base/Task.hh"
+#include "../base/SlabPool.hh"
+#include "Callbacks.hh"
+#include "TimerId.hh"
 
 #include <functional>
 #include <vector>
 #include <atomic>
 #include <memory>
-#include <mutex>
 
+class Buffer;
 class Channel;
 class Poller;
+class TimerQueue;
 
 /* EventLoop事件循环类 主要包含Channel和Poller(epoll)两大模块 */
 class EventLoop : noncopyable {
 public:
-    /* 回调的类型 */
-    using Functor = std::function<void()>;
+    /* 回调的类型 只能移动 小于Task::kInlineSize的可调用对象不分配内存 */
+    using Functor = Task;
 
     EventLoop();
     ~EventLoop();
@@ -27,16 +33,41 @@ public:
     void loop();
     /* 退出事件循环 */
     void quit();
+    /* 是否正在loop()中 退出循环之后queueInLoop的回调不会再执行 */
+    bool isLooping() const { return looping_; }
 
+    /*
+        每轮循环在poll返回后读取一次时钟并缓存 同一轮中处理事件时直接使用缓存的时间
+        pollReturnTime为墙上时间 monotonicNow为单调时钟的时间
+    */
     Timestamp pollReturnTime() const { return pollReturnTime_; }
+    Timestamp monotonicNow() const { return monotonicNow_; }
 
     /* 在当前loop中执行cb */
     void runInLoop(Functor cb);
     /* 把cb放入队列中 唤醒loop所在线程执行cb */
     void queueInLoop(Functor cb);
+    /*
+        在本轮循环的最后(处理完所有就绪事件和queueInLoop的回调之后)执行cb 只能在loop线程中调用
+        用于把一轮循环中产生的多次操作合并成一次 如TcpConnection的cork模式合并发送
+    */
+    void queueAfterEvents(Functor cb);
+
+    /* 定时器 线程安全 回调总是在loop线程中执行 */
+    /* 在time时刻(墙上时间)执行cb 定时器内部使用单调时钟 添加之后系统时间的调整不影响到期时刻 */
+    TimerId runAt(Timestamp time, TimerCallback cb);
+    /* delay秒后执行cb */
+    TimerId runAfter(double delay, TimerCallback cb);
+    /* 每interval秒执行一次cb */
+    TimerId runEvery(double interval, TimerCallback cb);
+    /* 取消定时器 */
+    void cancel(TimerId timerId);
 
     /* mainloop唤醒subloop 唤醒loop所在线程 */
     void wakeup();
+    /* wakeup统计 实际写eventfd的次数 以及因为已经有未处理的唤醒而省掉的次数 */
+    uint64_t wakeupsWritten() const { return wakeupsWritten_.load(std::memory_order_relaxed); }
+    uint64_t wakeupsElided() const { return wakeupsElided_.load(std::memory_order_relaxed); }
 
     /* 更新Channel状态 调用Poller的方法*/
     void updateChannel(Channel* channel);
@@ -44,6 +75,32 @@ public:
     void removeChannel(Channel* channel);
     /* 判断Channel是否存在 调用Poller的方法 */
     bool hasChannel(Channel* channel);
+    /* 负载统计 线程安全 LoadBalancer在mainloop中读取 */
+    /* TcpServer分配到该loop且还没有关闭的连接数量 */
+    int connectionCount() const { return connectionCount_.load(std::memory_order_relaxed); }
+    void adjustConnectionCount(int delta) { connectionCount_.fetch_add(delta, std::memory_order_relaxed); }
+    /* 最近1到2秒内处理事件和回调花费的微秒数 不含阻塞在poll中的时间 */
+    int64_t recentBusyMicros() const;
+
+    /* Poller修改关注事件的系统调用次数 以及合并修改省掉的次数 只能在loop线程中调用 */
+    uint64_t pollerCtlCalls() const;
+    uint64_t pollerSavedCtlCalls() const;
+    /* Poller是否支持边缘触发 io_uring不支持 */
+    bool supportsEdgeTriggered() const;
+
+    /*
+        该loop的小对象内存池 只能在loop线程中分配 可以在任意线程中释放
+        连接对象和连接表等在loop线程中分配的对象使用它 建立和关闭连接时不调用malloc
+    */
+    const std::shared_ptr<SlabPool>& slabPool() const { return slabPool_; }
+
+    /*
+        loop线程中所有连接共用的接收缓冲区 只能在loop线程中使用
+        已经被取走还没有归还时(如在消息回调中重入)返回nullptr 用完后调用releaseReceiveBuffer归还
+        归还时缓冲区中不能有数据
+    */
+    Buffer* acquireReceiveBuffer();
+    void releaseReceiveBuffer() { receiveBufferInUse_ = false; }
 
     /* EventLoop是否在当前线程 */
     bool isInLoopThread() const { return threadId_ == CurrentThread::tid(); }
@@ -54,6 +111,10 @@ private:
     void handleRead();
     /* 执行回调 */
     void doPendingFunctors();
+    /* 执行本轮循环最后的回调 */
+    void doAfterEventsFunctors();
+    /* 本轮循环结束时 累计处理事件花费的时间 */
+    void recordBusyTime();
 
 
     using ChannelList = std::vector<Channel*>;
@@ -62,13 +123,21 @@ private:
     std::atomic_bool quit_;    /* 控制是否跳出loop */
 
     const pid_t threadId_; /* 当前loop所在线程的id(LWP) */  
+    std::shared_ptr<SlabPool> slabPool_; /* 最后一个使用它的对象释放后才析构 可能晚于EventLoop */
+    std::unique_ptr<Buffer> receiveBuffer_; /* 第一次使用时在loop线程中分配 */
+    bool receiveBufferInUse_;
 
     Timestamp pollReturnTime_; /* Poller返回发生事件的Channel的时间戳 */
+    Timestamp monotonicNow_;   /* Poller返回时单调时钟的时间 */
     std::unique_ptr<Poller> poller_; /* EventLoop管理的Poller */
+    std::unique_ptr<TimerQueue> timerQueue_; /* EventLoop管理的定时器队列 */
 
     /* 重要!!!!!!!!! */
     int wakeupFd_; 
     std::unique_ptr<Channel> wakeupChannel_; /* 用于封装wakeupFd_ */
+    std::atomic_bool wakeupPending_; /* 已经写过eventfd 但loop还没有处理 此时无需再次写eventfd */
+    std::atomic<uint64_t> wakeupsWritten_;
+    std::atomic<uint64_t> wakeupsElided_;
         /* 
             当mainloop获取一个新用户的Channel时
             通过轮询算法选择一个subloop
@@ -80,8 +149,18 @@ private:
     ChannelList activeChannels_; /* 发生事件的Channel列表 */
 
     std::atomic_bool callingPendingFunctors_; /* 标识当前loop是否有需要执行的回调 */
-    std::vector<Functor> pendingFunctors_; /* 存放loop需要执行的所有的回调操作 */
-    std::mutex mutex_; /* 用来保护pendingFunctors_ */
+    MpscQueue<Functor> pendingFunctors_; /* 存放loop需要执行的所有的回调操作 无锁 多个线程写入 仅loop线程取出 */
+    std::vector<Functor> runningFunctors_; /* doPendingFunctors每一批取出的回调 复用内存 */
+
+    bool callingAfterEventsFunctors_; /* 正在执行本轮循环最后的回调 只在loop线程中访问 */
+    std::vector<Functor> afterEventsFunctors_; /* 本轮循环最后执行的回调 只在loop线程中访问 */
+    std::vector<Functor> runningAfterEventsFunctors_;
+
+    std::atomic_int connectionCount_;
+    /* 按固定长度的时间窗口累计处理事件的时间 loop线程写入 其他线程读取 */
+    std::atomic<int64_t> busyWindowStart_;   /* 当前窗口开始的单调时钟时间 */
+    std::atomic<int64_t> busyInWindow_;      /* 当前窗口内的累计时间 */
+    std::atomic<int64_t> busyLastWindow_;    /* 上一个窗口的累计时间 */
 };
 
 
@@ -19,6 +19,8 @@ public:
                     , const std::string& name = std::string());
     ~EventLoopThread();
 
+    /* loop线程绑定的CPU 需要在startLoop之前设置 */
+    void setCpuAffinity(const std::vector<int>& cpus) { thread_.setCpuAffinity(cpus); }
     EventLoop* startLoop();
 private:
     void threadFunc();
@@ -1,5 +1,27 @@
 #include "EventLoopThreadPool.hh"
 #include "EventLoopThread.hh"
+#include "../base/Logger.hh"
+
+#include <sched.h>
+#include <errno.h>
+
+
+/* 进程允许使用的所有CPU */
+static std::vector<int> allowedCpus() {
+    std::vector<int> cpus;
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    if (::sched_getaffinity(0, sizeof(cpuset), &cpuset) < 0) {
+        LOG_ERROR("sched_getaffinity error:%d \n", errno);
+        return cpus;
+    }
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++ cpu) {
+        if (CPU_ISSET(cpu, &cpuset)) {
+            cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+}
 
 
 EventLoopThreadPool::EventLoopThreadPool(EventLoop* baseloop, const std::string& nameArg) 
@@ -8,6 +30,7 @@ EventLoopThreadPool::EventLoopThreadPool(EventLoop* baseloop, const std::string&
     , started_(false)
     , numThreads_(0)
     , next_(0)
+    , autoCpuAffinity_(false)
     {
 }
 
@@ -17,6 +40,10 @@ EventLoopThreadPool::~EventLoopThreadPool() {
 
 void EventLoopThreadPool::start(const ThreadInitCallback& cb) {
     started_ = true;
+    std::vector<int> cpus(cpus_);
+    if (cpus.empty() && autoCpuAffinity_) {
+        cpus = allowedCpus();
+    }
     /* 服务器开启多个线程 */
     for (int i = 0; i < numThreads_; ++ i) {
         /* 线程名 = 线程池名 + 序号 */
@@ -24,11 +51,21 @@ void EventLoopThreadPool::start(const ThreadInitCallback& cb) {
         snprintf(buf, sizeof(buf), "%s%d", name_.c_str(), i);
         /* 创建EventLoopThread并加入线程池 */
         EventLoopThread* t = new EventLoopThread(cb, buf);
+        if (!cpus.empty()) {
+            t->setCpuAffinity(std::vector<int>(1, cpus[i % cpus.size()]));
+        }
         threads_.push_back(std::unique_ptr<EventLoopThread>(t));
         /* 启动线程 绑定一个EventLoop 并获得线程对应绑定的loop地址 */
         loops_.push_back(t->startLoop());
     }
 
+    if (!loops_.empty()) {
+        if (!balancer_) {
+            balancer_.reset(LoadBalancer::newLoadBalancer(LoadBalancer::kRoundRobin));
+        }
+        balancer_->init(loops_);
+    }
+
     /* 服务器只有一个线程 baseloop(mainloop) */
     if (numThreads_ == 0 && cb) {
         cb(baseloop_);
@@ -50,6 +87,14 @@ EventLoop* EventLoopThreadPool::getNextLoop() {
     return loop;
 }
 
+/* 只有baseloop时总是返回baseloop */
+EventLoop* EventLoopThreadPool::getNextLoop(const InetAddress& peerAddr) {
+    if (loops_.empty()) {
+        return baseloop_;
+    }
+    return balancer_->select(peerAddr);
+}
+
 std::vector<EventLoop*> EventLoopThreadPool::getAllLoops() {
     if (loops_.empty()) { 
         /* 如果仅有baseloop */
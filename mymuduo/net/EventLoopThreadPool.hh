@@ -2,6 +2,7 @@
 #define   __EVENTLOOPTHREADPOOL_HH_
 
 #include "../base/noncopyable.hh"
+#include "LoadBalancer.hh"
 
 #include <functional>
 #include <string>
@@ -10,6 +11,7 @@
 
 class EventLoop;
 class EventLoopThread;
+class InetAddress;
 
 class EventLoopThreadPool : noncopyable {
 public:
@@ -19,10 +21,22 @@ public:
     ~EventLoopThreadPool();
 
     void setThreadNum(int numThreads) { numThreads_ = numThreads; }
+    /*
+        绑定subloop线程的CPU 需要在start之前设置
+        setCpuAffinity: 第i个subloop绑定到cpus[i % cpus.size()]
+        setAutoCpuAffinity: 第i个subloop依次绑定到进程允许使用的CPU上 线程数多于CPU数时循环使用
+        loop线程中分配的连接缓冲区等内存按首次写入分配在本地NUMA节点上
+    */
+    void setCpuAffinity(const std::vector<int>& cpus) { cpus_ = cpus; }
+    void setAutoCpuAffinity(bool on) { autoCpuAffinity_ = on; }
+    /* 设置为新连接选择subloop的策略 需要在start之前设置 默认轮询 */
+    void setLoadBalancer(std::unique_ptr<LoadBalancer> balancer) { balancer_ = std::move(balancer); }
     void start(const ThreadInitCallback& cb = ThreadInitCallback());
 
     /* 如果工作在多线程中 baseloop_会默认以轮询方式分配Channel给subloop */
     EventLoop* getNextLoop();
+    /* 按LoadBalancer的策略为来自peerAddr的新连接选择subloop */
+    EventLoop* getNextLoop(const InetAddress& peerAddr);
 
     std::vector<EventLoop*> getAllLoops();
 
@@ -35,8 +49,11 @@ private:
     bool started_;
     int numThreads_;
     int next_;
+    std::vector<int> cpus_;  /* subloop依次绑定的CPU */
+    bool autoCpuAffinity_;
     std::vector<std::unique_ptr<EventLoopThread>> threads_; /* 存放所有的事件循环线程 */
     std::vector<EventLoop*> loops_; /* 存放所有事件循环线程绑定的loop指针 */
+    std::unique_ptr<LoadBalancer> balancer_; /* 选择subloop的策略 */
 };
 
 
@@ -0,0 +1,167 @@
+#include "LoadBalancer.hh"
+#include "EventLoop.hh"
+#include "InetAddress.hh"
+
+#include <algorithm>
+#include <utility>
+#include <stdint.h>
+
+
+/* 64位整数的混合函数(murmur3 fmix64) 输入相近时输出也分散 */
+static uint64_t mix64(uint64_t k) {
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdULL;
+    k ^= k >> 33;
+    k *= 0xc4ceb9fe1a85ec53ULL;
+    k ^= k >> 33;
+    return k;
+}
+
+
+/* 轮询 */
+class RoundRobinBalancer : public LoadBalancer {
+public:
+    RoundRobinBalancer() : next_(0) {}
+
+    void init(const std::vector<EventLoop*>& loops) override { loops_ = loops; }
+
+    EventLoop* select(const InetAddress&) override {
+        EventLoop* loop = loops_[next_];
+        if (++ next_ >= loops_.size()) {
+            next_ = 0;
+        }
+        return loop;
+    }
+
+private:
+    std::vector<EventLoop*> loops_;
+    size_t next_;
+};
+
+
+/* 最少连接数 连接数相同时从上次选择的下一个开始 避免总是选中第一个subloop */
+class LeastConnectionsBalancer : public LoadBalancer {
+public:
+    LeastConnectionsBalancer() : next_(0) {}
+
+    void init(const std::vector<EventLoop*>& loops) override { loops_ = loops; }
+
+    EventLoop* select(const InetAddress&) override {
+        size_t n = loops_.size();
+        size_t best = next_;
+        int bestCount = loops_[best]->connectionCount();
+        for (size_t i = 1; i < n && bestCount > 0; ++ i) {
+            size_t idx = (next_ + i) % n;
+            int count = loops_[idx]->connectionCount();
+            if (count < bestCount) {
+                best = idx;
+                bestCount = count;
+            }
+        }
+        next_ = (best + 1) % n;
+        return loops_[best];
+    }
+
+private:
+    std::vector<EventLoop*> loops_;
+    size_t next_;
+};
+
+
+/*
+    power of two choices 随机选两个不同的subloop 选择负载较低的一个
+    负载为最近处理事件花费的时间 相同时(如都空闲)比较连接数
+    只比较两个 不需要扫描所有subloop 也不会让所有新连接同时涌向同一个最空闲的subloop
+*/
+class PowerOfTwoChoicesBalancer : public LoadBalancer {
+public:
+    PowerOfTwoChoicesBalancer() : state_(0x9e3779b97f4a7c15ULL) {}
+
+    void init(const std::vector<EventLoop*>& loops) override { loops_ = loops; }
+
+    EventLoop* select(const InetAddress&) override {
+        size_t n = loops_.size();
+        if (n == 1) {
+            return loops_[0];
+        }
+        size_t a = static_cast<size_t>(random() % n);
+        size_t b = static_cast<size_t>(random() % (n - 1));
+        if (b >= a) {
+            /* 保证两个下标不同 */
+            ++ b;
+        }
+        return lessLoaded(loops_[a], loops_[b]) ? loops_[a] : loops_[b];
+    }
+
+private:
+    /* xorshift64* 伪随机数 只在mainloop中使用 */
+    uint64_t random() {
+        state_ ^= state_ >> 12;
+        state_ ^= state_ << 25;
+        state_ ^= state_ >> 27;
+        return state_ * 0x2545f4914f6cdd1dULL;
+    }
+
+    static bool lessLoaded(EventLoop* lhs, EventLoop* rhs) {
+        int64_t lhsBusy = lhs->recentBusyMicros();
+        int64_t rhsBusy = rhs->recentBusyMicros();
+        if (lhsBusy != rhsBusy) {
+            return lhsBusy < rhsBusy;
+        }
+        return lhs->connectionCount() <= rhs->connectionCount();
+    }
+
+    std::vector<EventLoop*> loops_;
+    uint64_t state_;
+};
+
+
+/*
+    对端ip的一致性哈希 每个subloop在哈希环上有kVirtualNodes个虚拟节点
+    同一个客户端ip的连接总是分配到同一个subloop 相关的状态可以留在该线程的缓存中
+    不考虑端口 同一个客户端的多个连接也在同一个subloop
+*/
+class ConsistentHashBalancer : public LoadBalancer {
+public:
+    static const int kVirtualNodes = 160;
+
+    void init(const std::vector<EventLoop*>& loops) override {
+        ring_.clear();
+        ring_.reserve(loops.size() * kVirtualNodes);
+        for (size_t i = 0; i < loops.size(); ++ i) {
+            for (int v = 0; v < kVirtualNodes; ++ v) {
+                uint64_t key = mix64((static_cast<uint64_t>(i) << 32) | static_cast<uint64_t>(v));
+                ring_.push_back(std::make_pair(key, loops[i]));
+            }
+        }
+        std::sort(ring_.begin(), ring_.end());
+    }
+
+    EventLoop* select(const InetAddress& peerAddr) override {
+        uint64_t key = mix64(peerAddr.getSockAddr()->sin_addr.s_addr);
+        /* 哈希环上顺时针方向的第一个节点 */
+        auto it = std::lower_bound(ring_.begin(), ring_.end(), std::make_pair(key, static_cast<EventLoop*>(nullptr)));
+        if (it == ring_.end()) {
+            it = ring_.begin();
+        }
+        return it->second;
+    }
+
+private:
+    std::vector<std::pair<uint64_t, EventLoop*>> ring_; /* 按哈希值排序的虚拟节点 */
+};
+
+
+LoadBalancer* LoadBalancer::newLoadBalancer(Strategy strategy) {
+    switch (strategy) {
+    case kLeastConnections:
+        return new LeastConnectionsBalancer();
+    case kPowerOfTwoChoices:
+        return new PowerOfTwoChoicesBalancer();
+    case kConsistentHash:
+        return new ConsistentHashBalancer();
+    case kRoundRobin:
+    default:
+        return new RoundRobinBalancer();
+    }
+}
@@ -0,0 +1,36 @@
+#ifndef   __LOADBALANCER_HH_
+#define   __LOADBALANCER_HH_
+
+#include "../base/noncopyable.hh"
+
+#include <vector>
+
+class EventLoop;
+class InetAddress;
+
+/*
+    LoadBalancer抽象类 mainloop为新连接选择subloop的策略
+    只在mainloop中调用 实现不需要加锁
+*/
+class LoadBalancer : noncopyable {
+public:
+    enum Strategy {
+        kRoundRobin,        /* 轮询 */
+        kLeastConnections,  /* 选择连接数最少的subloop */
+        kPowerOfTwoChoices, /* 随机选两个subloop 选择最近处理事件时间较少的 相同时比较连接数 */
+        kConsistentHash     /* 对端ip的一致性哈希 同一个客户端总是分配到同一个subloop */
+    };
+
+    virtual ~LoadBalancer() = default;
+
+    /* 线程池启动后 传入所有的subloop 只调用一次 */
+    virtual void init(const std::vector<EventLoop*>& loops) = 0;
+    /* 为来自peerAddr的新连接选择一个subloop */
+    virtual EventLoop* select(const InetAddress& peerAddr) = 0;
+
+    /* 创建内置策略的实现 */
+    static LoadBalancer* newLoadBalancer(Strategy strategy);
+};
+
+
+#endif // __LOADBALANCER_HH_
@@ -1,10 +1,31 @@
 #include "Poller.hh"
 #include "Channel.hh"
 
+#include <algorithm>
+
 /* channel是否在当前Poller中 */
 bool Poller::hasChannel(Channel* channel) const {
-    auto it = channels_.find(channel->fd());
-    return it != channels_.end() && it->second == channel;
+    return findChannel(channel->fd()) == channel;
+}
+
+/* 记录fd对应的Channel */
+void Poller::addToChannels(int fd, Channel* channel) {
+    if (static_cast<size_t>(fd) >= channels_.size()) {
+        /* 按需扩容 至少翻倍 避免fd递增时频繁扩容 */
+        channels_.resize(std::max(static_cast<size_t>(fd) + 1, channels_.size() * 2), nullptr);
+    }
+    if (channels_[fd] == nullptr) {
+        ++ numChannels_;
+    }
+    channels_[fd] = channel;
+}
+
+/* 删除fd对应的Channel */
+void Poller::removeFromChannels(int fd) {
+    if (static_cast<size_t>(fd) < channels_.size() && channels_[fd] != nullptr) {
+        channels_[fd] = nullptr;
+        -- numChannels_;
+    }
 }
 
 
@@ -2,10 +2,10 @@
 #define   __POLLER_HH_
 
 #include "../base/noncopyable.hh"
-#include "../base/Timestamp.hh"
 
 #include <vector>
-#include <unordered_map>
+#include <stdint.h>
+#include <stddef.h>
 
 class Channel;
 class EventLoop;
@@ -15,24 +15,53 @@ class Poller : noncopyable {
 public:
     using ChannelList = std::vector<Channel*>;
 
-    Poller(EventLoop* loop) : ownerLoop_(loop) {}
+    Poller(EventLoop* loop) : numChannels_(0), ownerLoop_(loop) {}
     virtual ~Poller() = default;
 
-    /* 为所有IO复用方法 提供统一的接口 */
-    virtual Timestamp poll(int timeoutMs, ChannelList* activeChannels) = 0; /* epoll_wait */
+    /*
+        为所有IO复用方法 提供统一的接口
+        poll不读取时钟 由EventLoop在每轮循环中读取一次并缓存
+    */
+    virtual void poll(int timeoutMs, ChannelList* activeChannels) = 0; /* epoll_wait */
     virtual void updateChannel(Channel* channel) = 0;   /* epoll_ctl */
     virtual void removeChannel(Channel* Channel) = 0;   /* epoll_ctl */
     
     /* channel是否在当前Poller中 */
     bool hasChannel(Channel* channel) const;
 
+    /* 修改关注事件的系统调用次数 以及合并修改省掉的次数 只能在loop线程中调用 */
+    virtual uint64_t ctlCalls() const { return 0; }
+    virtual uint64_t savedCtlCalls() const { return 0; }
+    /*
+        是否支持边缘触发 Channel在边缘触发模式下关注的读写事件改变时不一定调用updateChannel
+        只有按pollEvents()注册一次就够用的实现(epoll)才能支持
+    */
+    virtual bool supportsEdgeTriggered() const { return false; }
+
     /* EventLoop可以通过该接口获得默认IO复用的具体实现 */
     static Poller* newDefaultPoller(EventLoop* loop); /* 我们并不在Poller.cc中提供该方法的实现 */
 protected:
-    /* key为sockfd value为sockfd所属的Channel */
-    using ChannelMap = std::unordered_map<int, Channel*>;
-    ChannelMap channels_;  /* 该Poller持有的所有Channel */
+    /* 记录fd对应的Channel */
+    void addToChannels(int fd, Channel* channel);
+    /* 删除fd对应的Channel */
+    void removeFromChannels(int fd);
+    /* fd对应的Channel 没有则返回nullptr */
+    Channel* findChannel(int fd) const {
+        return static_cast<size_t>(fd) < channels_.size() ? channels_[fd] : nullptr;
+    }
+    /* 该Poller持有的Channel数量 */
+    size_t numChannels() const { return numChannels_; }
+
 private:
+    /* 
+        下标为sockfd value为sockfd所属的Channel 没有Channel时为nullptr
+        fd是从小到大分配的小整数 直接用fd作下标 查找时不需要哈希 也没有哈希表节点的内存分配
+        数组随着出现的最大fd按需扩容
+    */
+    using ChannelTable = std::vector<Channel*>;
+    ChannelTable channels_;  /* 该Poller持有的所有Channel */
+    size_t numChannels_;
+
     EventLoop* ownerLoop_; /* 该Poller所属的EventLoop */
 };
 
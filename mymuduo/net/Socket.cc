@@ -20,8 +20,8 @@ void Socket::bindAddress(const InetAddress& localaddr) {
     }
 }
 
-void Socket::listen() {
-    if (0 != ::listen(sockfd_, 1024)) {
+void Socket::listen(int backlog) {
+    if (0 != ::listen(sockfd_, backlog)) {
         /* 设定listen失败属于严重错误 */
         LOG_FATAL("listen sockfd:%d fail\n", sockfd_);
     }
@@ -12,7 +12,8 @@ public:
 
     int fd() const { return sockfd_; }
     void bindAddress(const InetAddress& localaddr);
-    void listen();
+    /* backlog为已完成连接队列的长度 实际值受net.core.somaxconn限制 */
+    void listen(int backlog = 1024);
     int accept(InetAddress* peeraddr);
 
     void shutdownWrite();
@@ -3,6 +3,7 @@
 #include "Socket.hh"
 #include "Channel.hh"
 #include "EventLoop.hh"
+#include "TimingWheel.hh"
 
 #include <functional>
 #include <errno.h>
@@ -10,6 +11,8 @@
 #include <sys/socket.h>
 #include <string.h>
 #include <netinet/tcp.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 static EventLoop* CheckLoopNotNull(EventLoop* loop) {
     if (loop == nullptr) {
@@ -19,99 +22,188 @@ static EventLoop* CheckLoopNotNull(EventLoop* loop) {
     return loop;
 }
 
+/* 突发流量使inputBuffer_扩容超过该值时 数据处理完后立即释放 */
+static const size_t kMaxRetainedInputCapacity = 64 * 1024;
+
 TcpConnection::TcpConnection(EventLoop* loop,
                              const std::string& nameArg,
                              int sockfd,
                              const InetAddress& localAddr,
-                             const InetAddress& peerAddr) 
+                             const InetAddress& peerAddr,
+                             uint64_t id) 
     : loop_(CheckLoopNotNull(loop))
     , name_(nameArg)
+    , id_(id)
     , state_(kConnecting) /* 初始时正在连接 */
     , reading_(true)
-    , socket_(new Socket(sockfd))
-    , channel_(new Channel(loop, sockfd))
+    , outputPaused_(false)
+    , cork_(false)
+    , flushScheduled_(false)
+    , socket_(sockfd)
+    , channel_(loop, sockfd)
     , localAddr_(localAddr)
     , peerAddr_(peerAddr)
     , highWaterMark_(64 * 1024 * 1024) /* 64M */
+    , lowWaterMark_(0)
+    , aboveHighWaterMark_(false)
+    , pauseReadAbove_(0)
+    , resumeReadBelow_(0)
+    , lastActiveTick_(0)
     {
-        /* 为Channel设置回调 */
-        channel_->setReadCallback(
-            std::bind(&TcpConnection::handleRead, this, std::placeholders::_1)
+        /* 为Channel设置回调 只捕获this的lambda可以存放在std::function内部 不分配内存 */
+        channel_.setReadCallback(
+            [this](Timestamp receiveTime) { handleRead(receiveTime); }
         );
-        channel_->setWriteCallback(
-            std::bind(&TcpConnection::handleWrite, this)
+        channel_.setWriteCallback(
+            [this]() { handleWrite(); }
         );
-        channel_->setCloseCallback(
-            std::bind(&TcpConnection::handleClose, this)
+        channel_.setCloseCallback(
+            [this]() { handleClose(); }
         );
-        channel_->setErrorCallback(
-            std::bind(&TcpConnection::handleError, this)
+        channel_.setErrorCallback(
+            [this]() { handleError(); }
         );
         LOG_INFO("TcpConnection create[%s] at fd=%d \n", name_.c_str(), sockfd);
-        socket_->setKeepAlive(true);
+        socket_.setKeepAlive(true);
 }
 
 TcpConnection::~TcpConnection() {
     LOG_INFO("TcpConnection destroyed[%s] at fd=%d state=%d \n", 
-                name_.c_str(), channel_->fd(), (int)state_);
+                name_.c_str(), channel_.fd(), (int)state_);
 }
 
 
 void TcpConnection::handleRead(Timestamp receiveTime) {
+    if (!channel_.isReading()) {
+        /*
+            已经停止读 边缘触发模式下EPOLLIN一直是注册的
+            也可能是同一轮循环中 前面的回调停止了读
+        */
+        return;
+    }
     int savedErrno = 0;
-    /* fd数据写入缓冲区 */
-    ssize_t n = inputBuffer_.readFd(channel_->fd(), &savedErrno);
-    if (n > 0) {
-        /* 已连接的客户 有可读事件发生 调用用户传入的回调onMessage */
-        messageCallback_(shared_from_this(), &inputBuffer_, receiveTime);
-        /* 注意 shared_from_this不属于std:: */
-    } else if (n == 0) {
+    ssize_t m = 0; /* 最后一次readFd的返回值 */
+    /* 
+        fd数据写入缓冲区
+        边缘触发模式下必须一直读到EAGAIN 否则剩余的数据不会再触发可读事件
+        每读一次就调用一次onMessage 回调中停止了读(背压)就不再继续读 恢复读时会再读一次
+    */
+    do {
+        m = readInput(receiveTime, &savedErrno);
+    } while (m > 0 && channel_.isEdgeTriggered() && channel_.isReading());
+
+    if (inputBuffer_.capacity() > kMaxRetainedInputCapacity) {
+        /* 数据已经处理完 不保留突发时扩容的大块内存 */
+        inputBuffer_.release();
+    }
+
+    if (m == 0) {
         /* 客户端断开连接 */
         handleClose();
-    } else {
-        /* 出错 */
+    } else if (m < 0 && savedErrno != EAGAIN && savedErrno != EWOULDBLOCK) {
+        /* 出错 (读到EAGAIN说明数据已经读完了 边缘触发模式下总是以EAGAIN结束) */
         errno = savedErrno;
         LOG_ERROR("TcpConnection::handleRead error \n");
         handleError(); /* 当错误发生时 发生错误的sockfd会被标记为可读写 */
     }
 }
 
+/* 读一次fd 读到数据时调用onMessage 返回readFd的返回值 */
+ssize_t TcpConnection::readInput(Timestamp receiveTime, int* savedErrno) {
+    Buffer* shared = loop_->acquireReceiveBuffer();
+    ssize_t n = 0;
+    if (shared != nullptr && inputBuffer_.readableBytes() == 0) {
+        /*
+            没有上次残留的数据 直接读到loop共用的接收缓冲区中 交给onMessage
+            回调处理完整的小消息后不剩数据 连接自己的inputBuffer_不分配也不扩容
+        */
+        inputBuffer_.swap(*shared);
+        n = inputBuffer_.readFd(channel_.fd(), savedErrno);
+        if (n > 0) {
+            touch();
+            messageCallback_(shared_from_this(), &inputBuffer_, receiveTime);
+        }
+        inputBuffer_.swap(*shared);
+        if (shared->readableBytes() > 0) {
+            /* 回调没有取走的不完整消息 拷贝到连接自己的缓冲区中 */
+            inputBuffer_.append(shared->peek(), shared->readableBytes());
+            shared->retrieveAll();
+        }
+        loop_->releaseReceiveBuffer();
+        return n;
+    }
+    if (shared != nullptr) {
+        /* 有残留的数据 读到inputBuffer_后面 放不下的部分先读到共用的接收缓冲区中 不需要栈上的64K */
+        n = inputBuffer_.readFd(channel_.fd(), savedErrno, shared->beginWrite(), shared->writableBytes());
+        loop_->releaseReceiveBuffer();
+    } else {
+        /* 在其他连接的消息回调中重入 共用的接收缓冲区正在使用 */
+        n = inputBuffer_.readFd(channel_.fd(), savedErrno);
+    }
+    if (n > 0) {
+        touch();
+        /* 已连接的客户 有可读事件发生 调用用户传入的回调onMessage */
+        messageCallback_(shared_from_this(), &inputBuffer_, receiveTime);
+        /* 注意 shared_from_this不属于std:: */
+    }
+    return n;
+}
+
 void TcpConnection::handleWrite() {
     /* 判断channel是否注册了写事件 */
-    if (channel_->isWriting()) {
+    if (channel_.isWriting()) {
         int saveErrno = 0;
-        /* 将缓冲区中的数据写入fd */
-        ssize_t n = outputBuffer_.writeFd(channel_->fd(), &saveErrno);
+        /* 将缓冲区中的数据写入fd 写出的数据已经从Buffer中删掉 */
+        ssize_t n = writeOutput(&saveErrno);
         if (n > 0) {
-            /* 成功写出数据 从Buffer中删掉写出的n个字符 */
-            outputBuffer_.retrieve(n);
+            outputDecreased();
+            touch();
             if (outputBuffer_.readableBytes() == 0) {
                 /* 发送完成了 设置channel不可写 */
-                channel_->disableWriting();
+                channel_.disableWriting();
                 if (writeCompleteCallback_) {
                     /* 如果注册过写完的回调 调用它 */
-                    loop_->queueInLoop(
-                        std::bind(writeCompleteCallback_, shared_from_this())
-                    );
+                    queueWriteComplete();
                 }
                 if (state_ == kDisconnecting) {
                     /* 连接正在断开 */
                     shutdownInLoop();
                 }
             }
-        } else { /* n <= 0 */
-            /* 出错了 */
-            LOG_ERROR("TcpConnection::handleWrite error \n");
         }
-    } else {
-        LOG_ERROR("TcpConnection fd=%d is down, no more writing \n", channel_->fd());
+        if (saveErrno != 0 && saveErrno != EWOULDBLOCK && saveErrno != EAGAIN) {
+            /* 出错了 对端已关闭或者文件被截断 剩余的数据再也发不出去 关闭连接 避免可写事件一直触发 */
+            LOG_ERROR("TcpConnection::handleWrite error:%d \n", saveErrno);
+            forceClose();
+        }
+    } else if (!channel_.isEdgeTriggered()) {
+        /* 边缘触发模式下EPOLLOUT一直是注册的 没有待发数据时收到可写事件是正常的 */
+        LOG_ERROR("TcpConnection fd=%d is down, no more writing \n", channel_.fd());
     }
 }
 
+/*
+    把outputBuffer_中的数据写到socket 并删掉已经写出的数据 返回写出的字节数 出错时设置savedErrno
+    一次writeFd可能只写到file段为止(或者最多IOV_MAX个段) socket不一定写满
+    边缘触发模式下不会再有可写事件 需要一直写到EAGAIN或者写完
+*/
+ssize_t TcpConnection::writeOutput(int* savedErrno) {
+    ssize_t total = 0;
+    do {
+        ssize_t n = outputBuffer_.writeFd(channel_.fd(), savedErrno);
+        if (n <= 0) {
+            break;
+        }
+        outputBuffer_.retrieve(n);
+        total += n;
+    } while (channel_.isEdgeTriggered() && !outputBuffer_.empty());
+    return total;
+}
+
 void TcpConnection::handleClose() {
-    LOG_INFO("fd=%d state=%d \n", channel_->fd(), (int)state_);
+    LOG_INFO("fd=%d state=%d \n", channel_.fd(), (int)state_);
     setState(kDisconnected); /* 设置已断开状态 */
-    channel_->disableAll();  /* 摘下所有监听事件 */
+    channel_.disableAll();  /* 摘下所有监听事件 */
 
     TcpConnectionPtr guardThis(shared_from_this());
     connectionCallback_(guardThis); /* 执行连接关闭的回调 */
@@ -123,7 +215,7 @@ void TcpConnection::handleError() {
     socklen_t optlen = static_cast<socklen_t>(sizeof(optval));
     int err = 0;
     /* 获取socket的错误 */
-    if (::getsockopt(channel_->fd(), SOL_SOCKET, SO_ERROR, &optval, &optlen) < 0) {
+    if (::getsockopt(channel_.fd(), SOL_SOCKET, SO_ERROR, &optval, &optlen) < 0) {
         err = errno;
     } else {
         err = optval;
@@ -133,20 +225,69 @@ void TcpConnection::handleError() {
 
 
 
-/* 发送数据 调用sendInLoop */
+/* 发送数据 其他线程调用时拷贝一次 */
 void TcpConnection::send(const std::string& str) {
+    send(str.data(), str.size());
+}
+
+/* 发送数据 其他线程调用时移动到loop线程 不拷贝 */
+void TcpConnection::send(std::string&& str) {
     if (state_ == kConnected) {
-        /* 由loop线程发送数据 */
         if (loop_->isInLoopThread()) {
-            sendInLoop(str.c_str(), str.size());
+            sendInLoop(str.data(), str.size());
         } else {
-            loop_->runInLoop(std::bind(&TcpConnection::sendInLoop, this, str.c_str(), str.size()));
+            send(std::shared_ptr<const std::string>(std::make_shared<std::string>(std::move(str))));
+        }
+    }
+}
+
+/* 发送数据 其他线程调用时拷贝一次 */
+void TcpConnection::send(const void* data, size_t len) {
+    if (state_ == kConnected) {
+        if (loop_->isInLoopThread()) {
+            sendInLoop(data, len);
+        } else {
+            /* 调用者的内存在返回后就可能失效 必须拷贝 */
+            send(std::shared_ptr<const std::string>(
+                std::make_shared<std::string>(static_cast<const char*>(data), len)));
+        }
+    }
+}
+
+/* 发送Buffer中的全部数据 其他线程调用时交换出Buffer的内容 不拷贝 */
+void TcpConnection::send(Buffer* buf) {
+    if (state_ == kConnected) {
+        if (loop_->isInLoopThread()) {
+            sendInLoop(buf->peek(), buf->readableBytes());
+            buf->retrieveAll();
+        } else {
+            std::shared_ptr<Buffer> owned(std::make_shared<Buffer>(0));
+            owned->swap(*buf);
+            TcpConnectionPtr conn(shared_from_this());
+            loop_->runInLoop([conn, owned]() {
+                conn->sendInLoop(owned->peek(), owned->readableBytes(), owned);
+            });
+        }
+    }
+}
+
+/* 发送共享的数据 不拷贝 */
+void TcpConnection::send(std::shared_ptr<const std::string> str) {
+    if (state_ == kConnected) {
+        if (loop_->isInLoopThread()) {
+            sendInLoop(str->data(), str->size(), str);
+        } else {
+            /* 捕获shared_ptr 保证回调执行时连接和数据都还有效 */
+            TcpConnectionPtr conn(shared_from_this());
+            loop_->runInLoop([conn, str]() {
+                conn->sendInLoop(str->data(), str->size(), str);
+            });
         }
     }
 }
 
 /* 由当前loop线程发送数据 */
-void TcpConnection::sendInLoop(const void* data, size_t len) {
+void TcpConnection::sendInLoop(const void* data, size_t len, std::shared_ptr<const void> owner) {
     /*
         发送数据时 应用写的快 但是内核发送数据慢
         需要将待发送数据写入发送缓冲区 而且有高水位回调 防止发送太快
@@ -159,16 +300,16 @@ void TcpConnection::sendInLoop(const void* data, size_t len) {
         LOG_ERROR("TcpConnection::sendInLoop disconnected give up writing\n");
         return;
     }
-    /* 该channel第一次开始发送数据 缓冲区中无数据待发 */
-    if (!channel_->isWriting() && outputBuffer_.readableBytes() == 0) {
+    /* 该channel第一次开始发送数据 缓冲区中无数据待发 cork模式下留到本轮循环最后一起发送 */
+    if (!cork_ && !channel_.isWriting() && outputBuffer_.readableBytes() == 0) {
         /* 尝试直接发送 */
-        nwrote = ::write(channel_->fd(), data, len);
+        nwrote = ::write(channel_.fd(), data, len);
         if (nwrote >= 0) {
             /* 发送成功了 */
             remaining = len - nwrote; /* 剩下多少 */
             if (remaining == 0 && writeCompleteCallback_) {
                 /* 全部发送成功 无需缓冲  也无需给channel注册EPOLLOUT事件了 也就不会执行handleWrite方法了 */
-                loop_->queueInLoop(std::bind(writeCompleteCallback_, shared_from_this())); /* 执行发送完成回调 */
+                queueWriteComplete(); /* 执行发送完成回调 */
             }
         } else { /* nwrote < 0  出错 */
             nwrote = 0;
@@ -188,29 +329,242 @@ void TcpConnection::sendInLoop(const void* data, size_t len) {
         (只有发送缓冲区中的数据全部发送完毕 才会将channel的EPOLLOUT事件关闭)
     */
     if (!faultError && remaining > 0) {
-        size_t oldLen = outputBuffer_.readableBytes(); /* 原待发数据量 */
-        if (oldLen + remaining >= highWaterMark_ /* 现在的待发数据 超过了高水位标记 */
-                    && oldLen < highWaterMark_   /* 原待发数据不会超过高水位标记 如果超过了 肯定已经调用过高水位回调 */
-                    && highWaterMarkCallback_){  /* 得设置过高水位回调 */
-            /* 执行高水位回调 */
-            loop_->queueInLoop(std::bind(highWaterMarkCallback_, shared_from_this(), oldLen + remaining));
+        outputIncreased(outputBuffer_.readableBytes(), remaining);
+        /* 剩余的数据写入输出缓冲区 有owner时直接引用 不拷贝 */
+        const char* rest = static_cast<const char*>(data) + nwrote;
+        if (owner) {
+            outputBuffer_.appendShared(std::move(owner), rest, remaining);
+        } else {
+            outputBuffer_.append(rest, remaining);
         }
-        /* 剩余的数据写入输出缓冲区 */
-        outputBuffer_.append(static_cast<const char*>(data) + nwrote, remaining);
-        if (!channel_->isWriting()) {
+        if (cork_) {
+            /* 本轮循环最后用一次writev发送 */
+            scheduleFlush();
+        } else if (!channel_.isWriting()) {
             /* 给channel设置EPOLLOUT事件 */
-            channel_->enableWriting();
+            channel_.enableWriting();
+        }
+    }
+}
+
+/* 零拷贝发送文件 其他线程调用时在loop线程中发送 */
+void TcpConnection::sendFile(int fd, off_t offset, size_t length) {
+    if (state_ == kConnected && length > 0) {
+        /* 发送可能在调用返回之后才完成 使用自己的fd 调用者可以立即关闭fd */
+        int fileFd = ::fcntl(fd, F_DUPFD_CLOEXEC, 0);
+        if (fileFd < 0) {
+            LOG_ERROR("TcpConnection::sendFile dup fd:%d error:%d \n", fd, errno);
+            return;
+        }
+        if (loop_->isInLoopThread()) {
+            sendFileInLoop(fileFd, offset, length);
+        } else {
+            TcpConnectionPtr conn(shared_from_this());
+            loop_->runInLoop([conn, fileFd, offset, length]() {
+                conn->sendFileInLoop(fileFd, offset, length);
+            });
+        }
+    }
+}
+
+/*
+    由当前loop线程发送文件
+    文件作为一个段追加到outputBuffer_ 排在之前的数据后面 由flushInLoop / handleWrite用sendfile发送
+*/
+void TcpConnection::sendFileInLoop(int fd, off_t offset, size_t length) {
+    if (state_ == kDisconnected) {
+        LOG_ERROR("TcpConnection::sendFileInLoop disconnected give up writing\n");
+        ::close(fd);
+        return;
+    }
+    outputIncreased(outputBuffer_.readableBytes(), length);
+    outputBuffer_.appendFile(fd, offset, length);
+    if (cork_) {
+        /* 本轮循环最后和其他数据一起发送 */
+        scheduleFlush();
+    } else {
+        /* 没有注册EPOLLOUT时尝试直接发送 发送不完再注册 */
+        flushInLoop();
+    }
+}
+
+/* 
+    在loop中排队执行写完成回调
+    只捕获TcpConnectionPtr 执行时再调用writeCompleteCallback_
+    避免拷贝std::function 闭包可以放在Task的内置缓冲区中 不需要分配内存
+*/
+void TcpConnection::queueWriteComplete() {
+    TcpConnectionPtr conn(shared_from_this());
+    loop_->queueInLoop([conn]() { conn->writeCompleteCallback_(conn); });
+}
+
+/* 有读写 记录最后活跃的tick O(1) 连接在时间轮中的位置由时间轮懒惰地调整 */
+void TcpConnection::touch() {
+    if (idleWheel_) {
+        lastActiveTick_ = idleWheel_->now();
+    }
+}
+
+/* 释放没有数据的输入输出缓冲区 */
+void TcpConnection::releaseIdleBuffers() {
+    inputBuffer_.release();
+    outputBuffer_.release();
+}
+
+/* 开始读socket 线程安全 */
+void TcpConnection::startRead() {
+    TcpConnectionPtr conn(shared_from_this());
+    loop_->runInLoop([conn]() { conn->startReadInLoop(); });
+}
+
+/* 停止读socket 线程安全 */
+void TcpConnection::stopRead() {
+    TcpConnectionPtr conn(shared_from_this());
+    loop_->runInLoop([conn]() { conn->stopReadInLoop(); });
+}
+
+void TcpConnection::startReadInLoop() {
+    reading_ = true;
+    updateReading();
+}
+
+void TcpConnection::stopReadInLoop() {
+    reading_ = false;
+    updateReading();
+}
+
+/* 根据reading_和outputPaused_ 关注 / 取消EPOLLIN */
+void TcpConnection::updateReading() {
+    if (state_ != kConnected && state_ != kDisconnecting) {
+        return;
+    }
+    bool wantRead = reading_ && !outputPaused_;
+    if (wantRead && !channel_.isReading()) {
+        channel_.enableReading();
+        if (channel_.isEdgeTriggered()) {
+            /*
+                边缘触发模式下 停止读期间到达的数据不会再产生新的边沿
+                需要主动读一次 把内核缓冲区中的数据读完
+            */
+            TcpConnectionPtr conn(shared_from_this());
+            loop_->queueInLoop([conn]() { conn->handleRead(conn->loop_->pollReturnTime()); });
+        }
+    } else if (!wantRead && channel_.isReading()) {
+        channel_.disableReading();
+    }
+}
+
+/* 待发数据增加added之前 检查高水位回调和自动停止读 */
+void TcpConnection::outputIncreased(size_t oldLen, size_t added) {
+    if (oldLen + added >= highWaterMark_ /* 现在的待发数据 超过了高水位标记 */
+                && oldLen < highWaterMark_){ /* 原待发数据不会超过高水位标记 如果超过了 肯定已经调用过高水位回调 */
+        aboveHighWaterMark_ = true;
+        if (highWaterMarkCallback_) {
+            /* 执行高水位回调 */
+            TcpConnectionPtr conn(shared_from_this());
+            size_t size = oldLen + added;
+            loop_->queueInLoop([conn, size]() { conn->highWaterMarkCallback_(conn, size); });
         }
     }
+    if (pauseReadAbove_ > 0 && !outputPaused_ && oldLen + added > pauseReadAbove_) {
+        /* 待发数据过多 停止读 对端收不到回复就不会继续发送请求 */
+        outputPaused_ = true;
+        updateReading();
+    }
+}
+
+/* 待发数据减少后 检查低水位回调和自动恢复读 */
+void TcpConnection::outputDecreased() {
+    size_t remaining = outputBuffer_.readableBytes();
+    if (aboveHighWaterMark_ && remaining <= lowWaterMark_) {
+        aboveHighWaterMark_ = false;
+        if (lowWaterMarkCallback_) {
+            TcpConnectionPtr conn(shared_from_this());
+            loop_->queueInLoop([conn, remaining]() { conn->lowWaterMarkCallback_(conn, remaining); });
+        }
+    }
+    if (outputPaused_ && remaining <= resumeReadBelow_) {
+        outputPaused_ = false;
+        updateReading();
+    }
+}
+
+/* 开启 / 关闭cork模式 线程安全 */
+void TcpConnection::setCork(bool on) {
+    TcpConnectionPtr conn(shared_from_this());
+    loop_->runInLoop([conn, on]() { conn->setCorkInLoop(on); });
+}
+
+void TcpConnection::setCorkInLoop(bool on) {
+    cork_ = on;
+    if (!on) {
+        flushInLoop();
+    }
+}
+
+/* 立即发送outputBuffer_中积累的数据 线程安全 */
+void TcpConnection::flush() {
+    TcpConnectionPtr conn(shared_from_this());
+    loop_->runInLoop([conn]() { conn->flushInLoop(); });
+}
+
+/* cork模式 在本轮循环的最后发送outputBuffer_中的数据 一轮循环只安排一次 */
+void TcpConnection::scheduleFlush() {
+    if (!flushScheduled_) {
+        flushScheduled_ = true;
+        TcpConnectionPtr conn(shared_from_this());
+        loop_->queueAfterEvents([conn]() { conn->flushInLoop(); });
+    }
+}
+
+/* 用一次writev发送outputBuffer_中的数据 发送不完再注册EPOLLOUT */
+void TcpConnection::flushInLoop() {
+    flushScheduled_ = false;
+    if (state_ == kDisconnected || channel_.isWriting() || outputBuffer_.empty()) {
+        /* 已经注册了EPOLLOUT 剩余数据由handleWrite发送 */
+        return;
+    }
+    int savedErrno = 0;
+    ssize_t n = writeOutput(&savedErrno);
+    if (n > 0) {
+        outputDecreased();
+    }
+    if (savedErrno != 0 && savedErrno != EWOULDBLOCK && savedErrno != EAGAIN) {
+        LOG_ERROR("TcpConnection::flushInLoop write error:%d \n", savedErrno);
+        forceClose();
+        return;
+    }
+    if (!outputBuffer_.empty()) {
+        /* socket发送缓冲区满了 剩余的数据等可写事件 */
+        channel_.enableWriting();
+    } else {
+        if (writeCompleteCallback_) {
+            queueWriteComplete();
+        }
+        if (state_ == kDisconnecting) {
+            shutdownInLoop();
+        }
+    }
+}
+
+/* 使用边缘触发模式 需要在connectEstablished之前设置 */
+void TcpConnection::setEdgeTriggered(bool on) {
+    channel_.setEdgeTriggered(on);
 }
 
 /* 连接建立 */
 void TcpConnection::connectEstablished() {
     setState(kConnected);
     /* 将TcpConnection管理的channel绑定到TcpConnection上 */
-    channel_->tie(shared_from_this());
-    /* 注册读事件 */
-    channel_->enableReading();
+    channel_.tie(shared_from_this());
+    /* 注册读事件 connectEstablished之前调用了stopRead时不读 */
+    if (reading_) {
+        channel_.enableReading();
+    }
+    if (idleWheel_) {
+        lastActiveTick_ = idleWheel_->now();
+        idleWheel_->add(shared_from_this());
+    }
     /* 新连接建立 执行回调 */
     connectionCallback_(shared_from_this());
 }
@@ -220,12 +574,12 @@ void TcpConnection::connectDestroyed() {
     if (state_ == kConnected) {
         setState(kDisconnected);
         /* 注销所有监听事件 */
-        channel_->disableAll();
+        channel_.disableAll();
         /* 连接销毁 执行回调 */
         connectionCallback_(shared_from_this());
     }
     /* 连接关闭了 就从EventLoop上取下 */
-    channel_->remove();
+    channel_.remove();
 }
 
 /* 关闭连接 调用shutdownInLoop */
@@ -238,9 +592,25 @@ void TcpConnection::shutdown() {
 
 /* 在当前loop中删除掉对应的channel */
 void TcpConnection::shutdownInLoop() {
-    if (!channel_->isWriting()) { /* 发送缓冲区中无待发数据了 */
+    if (!channel_.isWriting() && outputBuffer_.empty()) { /* 发送缓冲区中无待发数据了 cork模式下可能有还没发送的数据 */
         /* 关闭TCP的写端 会调用handleClose方法 */
-        socket_->shutdownWrite();
+        socket_.shutdownWrite();
         /* 关闭TCP写端 会触发socket的EPOLLHUP事件(EPOLLHUP不需要注册) */
     }
-}
\ No newline at end of file
+}
+
+/* 不等待待发数据发送完 直接关闭连接 线程安全 */
+void TcpConnection::forceClose() {
+    if (state_ == kConnected || state_ == kDisconnecting) {
+        setState(kDisconnecting);
+        TcpConnectionPtr conn(shared_from_this());
+        loop_->queueInLoop([conn]() { conn->forceCloseInLoop(); });
+    }
+}
+
+void TcpConnection::forceCloseInLoop() {
+    if (state_ == kConnected || state_ == kDisconnecting) {
+        /* 和对端关闭连接一样处理 */
+        handleClose();
+    }
+}
@@ -5,15 +5,17 @@
 #include "InetAddress.hh"
 #include "Callbacks.hh"
 #include "Buffer.hh"
+#include "ChainBuffer.hh"
+#include "Socket.hh"
+#include "Channel.hh"
 #include "../base/Timestamp.hh"
 
 #include <memory>
 #include <string>
 #include <atomic>
 
-class Channel;
 class EventLoop;
-class Socket;
+class TimingWheel;
 
 
 /* TcpConnection代表一条已经建立的客户端连接 */
@@ -23,23 +25,58 @@ public:
                   const std::string& nameArg,
                   int sockfd,
                   const InetAddress& localAddr,
-                  const InetAddress& peerAddr);
+                  const InetAddress& peerAddr,
+                  uint64_t id = 0);
     ~TcpConnection();
 
     EventLoop* getLoop() const { return loop_; }
     const std::string& name() const { return name_; }
+    uint64_t id() const { return id_; }
     const InetAddress& localAddress() const { return localAddr_; }
     const InetAddress& peerAddress() const { return peerAddr_; }
     Buffer* inputBuffer() { return &inputBuffer_; }
-    Buffer* outputBuffer() { return &outputBuffer_; }
+    ChainBuffer* outputBuffer() { return &outputBuffer_; }
 
     bool connected() const { return state_ == kConnected; }
     bool disconnected() const { return state_ == kDisconnected; }
 
-    /* 发送数据 调用sendInLoop */
+    /*
+        发送数据 调用sendInLoop 线程安全
+        在loop线程中调用时 先尝试直接写socket 写不完的部分才进入outputBuffer_
+        在其他线程中调用时 数据的所有权转交给loop线程:
+            const std::string& 和 (data, len) 拷贝一次
+            std::string&& 移动 不拷贝
+            Buffer* 交换出Buffer的内容 不拷贝 调用后buf为空
+            shared_ptr<const std::string> 共享 不拷贝 写不完的部分由outputBuffer_直接引用
+    */
     void send(const std::string& buf);
+    void send(std::string&& buf);
+    void send(const void* data, size_t len);
+    void send(Buffer* buf);
+    void send(std::shared_ptr<const std::string> buf);
+    /*
+        零拷贝发送文件fd中[offset, offset + length)的内容 使用sendfile(2) 数据不经过用户态 线程安全
+        内部dup了fd 调用返回后可以关闭fd 和前后send的数据按调用顺序发送
+        socket写满时等待可写事件继续发送 全部发送完成后调用writeComplete回调
+    */
+    void sendFile(int fd, off_t offset, size_t length);
     /* 关闭连接 调用shutdownInLoop */
     void shutdown();
+    /* 不等待待发数据发送完 直接关闭连接 线程安全 */
+    void forceClose();
+
+    /*
+        cork模式 send不立即写socket 数据先进入outputBuffer_
+        在本轮循环的最后(或者调用flush时) 用一次writev发送本轮积累的所有数据
+        适合一次onMessage中多次发送小数据的场景(如流水线请求的逐条回复) 减少系统调用和小TCP分段
+        线程安全 在loop线程中调用时立即生效 其他线程中调用时排队到loop线程中执行
+        关闭cork模式时立即发送积累的数据
+    */
+    void setCork(bool on);
+    /* 只能在loop线程中调用 */
+    bool isCorked() const { return cork_; }
+    /* 立即发送outputBuffer_中积累的数据 线程安全 */
+    void flush();
 
     /* 设置回调 */
     void setConnectionCallback(const ConnectionCallback& cb) { connectionCallback_ = cb; }
@@ -49,8 +86,42 @@ public:
         highWaterMarkCallback_ = cb;
         highWaterMark_ = highWaterMark;
     }
+    /* 超过高水位之后 待发数据回落到lowWaterMark及以下时调用 */
+    void setLowWaterMarkCallback(const LowWaterMarkCallback& cb, size_t lowWaterMark) {
+        lowWaterMarkCallback_ = cb;
+        lowWaterMark_ = lowWaterMark;
+    }
     void setCloseCallback(const CloseCallback& cb) { closeCallback_ = cb; }
 
+    /*
+        开始 / 停止读socket(关注 / 取消EPOLLIN) 线程安全 在loop线程中执行
+        停止读之后对端的数据留在内核接收缓冲区中 TCP流量控制会让对端慢下来
+    */
+    void startRead();
+    void stopRead();
+    bool isReading() const { return reading_; }
+
+    /*
+        待发数据超过pauseAbove时自动停止读 回落到resumeBelow及以下时自动恢复 pauseAbove为0表示不启用
+        和startRead/stopRead互不影响 只有两者都允许时才读socket
+        需要在connectEstablished之前设置
+    */
+    void setReadPauseThreshold(size_t pauseAbove, size_t resumeBelow) {
+        pauseReadAbove_ = pauseAbove;
+        resumeReadBelow_ = resumeBelow;
+    }
+
+    /* 使用边缘触发模式 需要在connectEstablished之前设置 */
+    void setEdgeTriggered(bool on);
+
+    /* 空闲超时 由所在loop的时间轮关闭长时间没有读写的连接 需要在connectEstablished之前设置 */
+    void setIdleWheel(const std::shared_ptr<TimingWheel>& wheel) { idleWheel_ = wheel; }
+    /* 最后一次读写时时间轮的tick */
+    uint64_t lastActiveTick() const { return lastActiveTick_; }
+
+    /* 输入输出缓冲区中没有数据时释放它们的内存 下次使用时重新分配 只能在loop线程中调用 */
+    void releaseIdleBuffers();
+
     /* 连接建立 */
     void connectEstablished();
     /* 连接销毁 */
@@ -63,22 +134,50 @@ private:
 
     /* 事件处理回调 */
     void handleRead(Timestamp receiveTime);
+    ssize_t readInput(Timestamp receiveTime, int* savedErrno);
     void handleWrite();
+    ssize_t writeOutput(int* savedErrno);
     void handleClose();
     void handleError();
 
-    /* 由当前loop发送数据 */
-    void sendInLoop(const void* message, size_t len);
+    /* 由当前loop发送数据 owner不为空时 写不完的部分直接引用owner管理的内存 */
+    void sendInLoop(const void* message, size_t len, std::shared_ptr<const void> owner = nullptr);
+    /* 由当前loop发送文件 fd由outputBuffer_接管 */
+    void sendFileInLoop(int fd, off_t offset, size_t length);
     /* 在当前loop中删除掉对应的channel */
     void shutdownInLoop();
+    void forceCloseInLoop();
+    /* 有读写 记录最后活跃的tick */
+    void touch();
+    /* 在loop中排队执行写完成回调 */
+    void queueWriteComplete();
+    /* 读socket的开关 */
+    void startReadInLoop();
+    void stopReadInLoop();
+    /* 根据reading_和outputPaused_ 关注 / 取消EPOLLIN */
+    void updateReading();
+    /* 待发数据增加added之前 检查高水位回调和自动停止读 */
+    void outputIncreased(size_t oldLen, size_t added);
+    /* 待发数据减少后 检查低水位回调和自动恢复读 */
+    void outputDecreased();
+    /* 开启 / 关闭cork模式 */
+    void setCorkInLoop(bool on);
+    /* cork模式 在本轮循环的最后发送outputBuffer_中的数据 */
+    void scheduleFlush();
+    void flushInLoop();
 
     EventLoop* loop_;        /* 从属的subloop */
     const std::string name_;
+    const uint64_t id_;      /* TcpServer分配的连接id */
     std::atomic_int state_;  /* TCP状态 */
-    bool reading_;
+    bool reading_;         /* 用户是否允许读 startRead/stopRead */
+    bool outputPaused_;    /* 待发数据过多 自动停止了读 */
+    bool cork_;            /* cork模式 合并一轮循环中的发送 */
+    bool flushScheduled_;  /* 已经在本轮循环的最后安排了flushInLoop */
 
-    std::unique_ptr<Socket> socket_;
-    std::unique_ptr<Channel> channel_;
+    /* 直接作为成员 和TcpConnection在同一块内存中 不单独分配 */
+    Socket socket_;
+    Channel channel_;
 
     const InetAddress localAddr_;
     const InetAddress peerAddr_;
@@ -87,11 +186,19 @@ private:
     MessageCallback messageCallback_;
     WriteCompleteCallback writeCompleteCallback_;
     HighWaterMarkCallback highWaterMarkCallback_; /* 高水位标记回调 */
+    LowWaterMarkCallback lowWaterMarkCallback_;   /* 低水位标记回调 */
     CloseCallback closeCallback_;
     size_t highWaterMark_; /* 高水位标记 */
+    size_t lowWaterMark_;  /* 低水位标记 */
+    bool aboveHighWaterMark_; /* 待发数据超过了高水位 还没有回落到低水位 */
+    size_t pauseReadAbove_;   /* 待发数据超过该值自动停止读 0表示不启用 */
+    size_t resumeReadBelow_;  /* 待发数据回落到该值自动恢复读 */
+
+    std::shared_ptr<TimingWheel> idleWheel_; /* 空闲超时的时间轮 为空表示不启用 */
+    uint64_t lastActiveTick_;
 
     Buffer inputBuffer_;    /* 接收数据缓冲区 */
-    Buffer outputBuffer_;   /* 发送数据缓冲区 */
+    ChainBuffer outputBuffer_; /* 发送数据缓冲区 分段 积压大量数据时不会整体搬移 */
 };
 
 
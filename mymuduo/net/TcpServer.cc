@@ -3,6 +3,8 @@
 #include "TcpConnection.hh"
 
 #include <string.h>
+#include <future>
+#include <chrono>
 
 static EventLoop* CheckLoopNotNull(EventLoop* loop) {
     if (loop == nullptr) {
@@ -18,44 +20,109 @@ const InetAddress& listenAddr,
 const std::string& nameArg, 
 Option option) 
     : loop_(CheckLoopNotNull(loop)) /* loop_初始化时必须不为空 */
+    , listenAddr_(listenAddr)
     , ipPort_(listenAddr.toIpPort())
     , name_(nameArg)
-    , acceptor_(new Acceptor(loop, listenAddr, option == kReusePort))
+    , option_(option)
+    /* kReusePortPerLoop时listenfd在start中由各个subloop创建 */
+    , acceptor_(option == kReusePortPerLoop ? nullptr : new Acceptor(loop, listenAddr, option == kReusePort))
     , threadPool_(new EventLoopThreadPool(loop, name_))
     , connectionCallback_()
     , messageCallback_()
     , started_(0)
+    , edgeTriggered_(false)
+    , pauseReadAbove_(0)
+    , resumeReadBelow_(0)
+    , idleTimeout_(0)
+    , bufferReleaseInterval_(0)
+    , listenBacklog_(1024)
+    , maxAcceptsPerRead_(16)
     , nextConnId_(1)
     {
-        /* 新用户连接时执行TcpServer::newConnection 分配subloop */
-        /* 运行在mainloop中 Acceptor::handleRead */
-        acceptor_->setNewConnectionCallback(
-            std::bind(&TcpServer::newConnection, 
-            this, std::placeholders::_1, std::placeholders::_2));
+        if (acceptor_) {
+            /* 新用户连接时执行TcpServer::newConnection 分配subloop */
+            /* 运行在mainloop中 Acceptor::handleRead */
+            acceptor_->setNewConnectionCallback(
+                std::bind(&TcpServer::newConnection, 
+                this, std::placeholders::_1, std::placeholders::_2));
+        }
 }
 
-/* 析构函数 关闭并释放所有的Tcp连接 */
+/*
+    析构函数 关闭并释放所有的Tcp连接
+    在每个subloop中执行并等待完成 此后不会再有使用TcpServer的回调(acceptor 建立连接)
+    subloop已经退出循环时(如setThreadNum(0) baseloop quit之后在其他线程中析构) 排队的回调不会执行
+    此时在当前线程中直接销毁 由claimed保证destroyShard只执行一次
+*/
 TcpServer::~TcpServer() {
-    for (auto& item : connections_) {
-        TcpConnectionPtr conn(item.second); /* TcpConnectionPtr是shared_ptr */
-        /* reset()方法会让item.second智能指针不再指向资源(TcpConnection)(引用计数-1) */
-        item.second.reset();
+    for (auto& item : shards_) {
+        LoopShardPtr shard(item.second);
+        if (shard->loop->isInLoopThread()) {
+            destroyShard(shard);
+            continue;
+        }
+        std::shared_ptr<std::atomic_bool> claimed(std::make_shared<std::atomic_bool>(false));
+        std::shared_ptr<std::promise<void>> done(std::make_shared<std::promise<void>>());
+        std::future<void> finished(done->get_future());
+        shard->loop->runInLoop([shard, claimed, done]() {
+            if (!claimed->exchange(true)) {
+                destroyShard(shard);
+                done->set_value();
+            }
+        });
+        while (finished.wait_for(std::chrono::milliseconds(100)) != std::future_status::ready) {
+            if (!shard->loop->isLooping() && !claimed->exchange(true)) {
+                destroyShard(shard);
+                break;
+            }
+        }
+    }
+}
+
+void TcpServer::destroyShard(const LoopShardPtr& shard) {
+    shard->acceptor.reset();
+    shard->loop->cancel(shard->bufferReleaseTimer);
+    if (shard->idleWheel) {
+        shard->idleWheel->stop();
+    }
+    ConnectionMap connections(shard->connections.get_allocator());
+    connections.swap(shard->connections);
+    for (auto& conn : connections) {
+        shard->loop->adjustConnectionCount(-1);
         /* 销毁连接 */
-        conn->getLoop()->runInLoop(std::bind(&TcpConnection::connectDestroyed, conn));
-        /* 离开作用域后conn指向的TcpConnection被析构 */
+        conn.second->connectDestroyed();
     }
+    /* 离开作用域后TcpConnection被析构 */
 }
 
 
 /* 当有新的客户端连接 acceptor对应的channel会执行Acceptor::handleRead回调 过程中会执行该newConnection回调 */
-/* 根据轮询算法选择一个subloop 唤醒subloop 把当前connfd封装为相应的channel 分发给subloop */
+/* 根据LoadBalancer的策略选择一个subloop 唤醒subloop 把当前connfd分发给subloop */
 void TcpServer::newConnection(int sockfd, const InetAddress& peerAddr) {
     /* 选择一个subloop来处理io事件 */
-    EventLoop* ioLoop = threadPool_->getNextLoop();
-    /* 新连接命名 */
+    newConnectionOnLoop(threadPool_->getNextLoop(peerAddr), sockfd, peerAddr);
+}
+
+/* 可能在mainloop或者ioLoop自己的线程中执行 shards_在start之后只读 nextConnId_是原子的 */
+void TcpServer::newConnectionOnLoop(EventLoop* ioLoop, int sockfd, const InetAddress& peerAddr) {
+    uint64_t connId = nextConnId_.fetch_add(1, std::memory_order_relaxed);
+    LoopShardPtr shard(shards_.find(ioLoop)->second);
+    /* 选中时就计入loop的连接数 LoadBalancer连续分配时能看到刚分配的连接 */
+    ioLoop->adjustConnectionCount(1);
+    /*
+        TcpConnection在subloop中创建 从subloop的SlabPool中分配 内存首次写入也在subloop的线程中
+        已经在subloop中时直接执行
+    */
+    ioLoop->runInLoop([this, shard, sockfd, peerAddr, connId]() {
+        establishConnection(shard, sockfd, peerAddr, connId);
+    });
+}
+
+void TcpServer::establishConnection(const LoopShardPtr& shard, int sockfd, const InetAddress& peerAddr, uint64_t connId) {
+    EventLoop* ioLoop = shard->loop;
+    /* 新连接的名字 */
     char buf[64] = {0};
-    snprintf(buf, sizeof(buf), "-%s#%d", ipPort_.c_str(), nextConnId_);
-    ++ nextConnId_;
+    snprintf(buf, sizeof(buf), "-%s#%ju", ipPort_.c_str(), static_cast<uintmax_t>(connId));
     std::string connName = name_ + buf;
     LOG_INFO("TcpServer::newConnection [%s] - new connection [%s] from %s \n",
              name_.c_str(), connName.c_str(), peerAddr.toIpPort().c_str());
@@ -67,22 +134,31 @@ void TcpServer::newConnection(int sockfd, const InetAddress& peerAddr) {
         LOG_ERROR("TcpServer::newConnection getLocalAddr error\n");
     }
     InetAddress localAddr(local);
-    /* 根据成功连接的sockfd创建TcpConnection连接对象 Socket Channel */
-    TcpConnectionPtr conn(new TcpConnection(ioLoop, connName, sockfd, localAddr, peerAddr));
-    /* 保存创建的连接 */
-    connections_[connName] = conn;
+    /* 根据成功连接的sockfd创建TcpConnection连接对象 对象和shared_ptr的控制块在一次分配中得到 */
+    TcpConnectionPtr conn(std::allocate_shared<TcpConnection>(
+        SlabAllocator<TcpConnection>(ioLoop->slabPool()),
+        ioLoop, connName, sockfd, localAddr, peerAddr, connId));
     /* 传入用户设置的回调 */
     /* 用户设置回调=>TcpServer=>TcpConnection=>Channel=>Poller=>notify Channel调用回调 */
+    conn->setEdgeTriggered(edgeTriggered_);
+    conn->setReadPauseThreshold(pauseReadAbove_, resumeReadBelow_);
+    conn->setIdleWheel(shard->idleWheel);
     conn->setConnectionCallback(connectionCallback_);
     conn->setMessageCallback(messageCallback_);
     conn->setWriteCompleteCallback(writeCompleteCallback_);
     /* 设置了如何关闭连接的回调 removeConnection */
+    std::weak_ptr<LoopShard> weakShard(shard);
     conn->setCloseCallback(
-        std::bind(&TcpServer::removeConnection, this, std::placeholders::_1)
+        std::bind(&TcpServer::removeConnection, weakShard, std::placeholders::_1)
     );
 
-    /* 有新的TCP连接创建了TcpConnection后 直接调用TcpConnection::connectEstablisted方法 */
-    ioLoop->runInLoop(std::bind(&TcpConnection::connectEstablished, conn));
+    /* 在subloop中保存连接 并调用TcpConnection::connectEstablisted方法 */
+    shard->connections[connId] = conn;
+    conn->connectEstablished();
+}
+
+void TcpServer::setLoadBalance(LoadBalancer::Strategy strategy) {
+    threadPool_->setLoadBalancer(std::unique_ptr<LoadBalancer>(LoadBalancer::newLoadBalancer(strategy)));
 }
 
 /* 设置subloop的数量 */
@@ -90,29 +166,77 @@ void TcpServer::setThreadNum(int numThreads) {
     threadPool_->setThreadNum(numThreads);
 }
 
+void TcpServer::setCpuAffinity(const std::vector<int>& cpus) {
+    threadPool_->setCpuAffinity(cpus);
+}
+
+void TcpServer::setAutoCpuAffinity(bool on) {
+    threadPool_->setAutoCpuAffinity(on);
+}
+
 /* 启动服务器 */
 void TcpServer::start() {
     if (started_ ++ == 0) {
         /* 防止TcpServer对象被start多次 */
         threadPool_->start(threadInitCallback_); /* subloop全部启动 */
-        loop_->runInLoop(std::bind(&Acceptor::listen, acceptor_.get())); /* 在mainloop上注册listenfd */
+        /* 每个subloop一个连接表 */
+        for (EventLoop* ioLoop : threadPool_->getAllLoops()) {
+            LoopShardPtr shard(std::make_shared<LoopShard>(ioLoop));
+            if (idleTimeout_ > 0) {
+                /* 每个subloop一个时间轮 在各自的loop线程中转动 */
+                shard->idleWheel = std::make_shared<TimingWheel>(ioLoop, idleTimeout_);
+                ioLoop->runInLoop(std::bind(&TimingWheel::start, shard->idleWheel));
+            }
+            if (bufferReleaseInterval_ > 0) {
+                std::weak_ptr<LoopShard> weakShard(shard);
+                shard->bufferReleaseTimer = ioLoop->runEvery(bufferReleaseInterval_, 
+                    std::bind(&TcpServer::releaseIdleBuffers, weakShard));
+            }
+            shards_[ioLoop] = shard;
+        }
+        if (option_ == kReusePortPerLoop) {
+            /* 每个subloop各自创建listenfd并在自己的线程中监听 */
+            for (auto& item : shards_) {
+                item.second->loop->runInLoop(std::bind(&TcpServer::startLoopAcceptor, this, item.second));
+            }
+        } else {
+            acceptor_->setBacklog(listenBacklog_);
+            acceptor_->setMaxAcceptsPerRead(maxAcceptsPerRead_);
+            loop_->runInLoop(std::bind(&Acceptor::listen, acceptor_.get())); /* 在mainloop上注册listenfd */
+        }
     }
     /* 调用完该方法 马上就会调用loop.loop()方法开启mainloop */
 }
 
-/* TcpConnection连接断开时 handleClose执行的回调 */
-void TcpServer::removeConnection(const TcpConnectionPtr& conn) {
-    loop_->runInLoop(std::bind(
-        &TcpServer::removeConnectionInLoop, this, conn
-    ));
+/* 在shard的subloop中执行 bind到同一个地址的SO_REUSEPORT listenfd 新连接直接在该subloop中建立 */
+void TcpServer::startLoopAcceptor(const LoopShardPtr& shard) {
+    shard->acceptor.reset(new Acceptor(shard->loop, listenAddr_, true));
+    shard->acceptor->setBacklog(listenBacklog_);
+    shard->acceptor->setMaxAcceptsPerRead(maxAcceptsPerRead_);
+    shard->acceptor->setNewConnectionCallback(
+        std::bind(&TcpServer::newConnectionOnLoop, 
+        this, shard->loop, std::placeholders::_1, std::placeholders::_2));
+    shard->acceptor->listen();
 }
-/* removeConnection调用的 在对应subloop中执行 */
-void TcpServer::removeConnectionInLoop(const TcpConnectionPtr& conn) {
-    LOG_INFO("TcpServer::removeConnectionInLoop [%s] - connection %s\n",
-              name_.c_str(), conn->name().c_str());
-    /* 在ConnectionMap中删除conn */
-    connections_.erase(conn->name());
-    /* 销毁TcpConnection::connectDestroyed */
-    EventLoop* ioLoop = conn->getLoop();
-    ioLoop->queueInLoop(std::bind(&TcpConnection::connectDestroyed, conn));
+
+/* 在shard的subloop中执行 */
+void TcpServer::releaseIdleBuffers(const std::weak_ptr<LoopShard>& weakShard) {
+    LoopShardPtr shard(weakShard.lock());
+    if (shard) {
+        for (auto& item : shard->connections) {
+            item.second->releaseIdleBuffers();
+        }
+    }
+}
+
+/* TcpConnection连接断开时 handleClose执行的回调 在连接所在的subloop中执行 不经过mainloop */
+void TcpServer::removeConnection(const std::weak_ptr<LoopShard>& weakShard, const TcpConnectionPtr& conn) {
+    LOG_INFO("TcpServer::removeConnection - connection %s\n", conn->name().c_str());
+    LoopShardPtr shard(weakShard.lock());
+    if (shard && shard->connections.erase(conn->id()) > 0) {
+        /* 在连接表中删除conn */
+        conn->getLoop()->adjustConnectionCount(-1);
+    }
+    /* 销毁TcpConnection::connectDestroyed 不能在handleClose的调用栈中直接销毁 */
+    conn->getLoop()->queueInLoop(std::bind(&TcpConnection::connectDestroyed, conn));
 }
\ No newline at end of file
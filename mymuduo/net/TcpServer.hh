@@ -10,6 +10,7 @@
 #include "Callbacks.hh"
 #include "TcpConnection.hh"
 #include "Buffer.hh"
+#include "TimingWheel.hh"
 
 #include <functional>
 #include <string>
@@ -22,7 +23,11 @@
 class TcpServer : noncopyable {
 public:
     using ThreadInitCallback = std::function<void(EventLoop*)>; /* EventLoopThread创建时对loop进行操作的回调类型 */
-    enum Option { kNoReusePort, kReusePort };
+    /*
+        kReusePortPerLoop 每个subloop在自己的线程中创建一个SO_REUSEPORT的listenfd
+        由内核把新连接分散到各个listenfd 连接在accept它的subloop中建立 不经过mainloop
+    */
+    enum Option { kNoReusePort, kReusePort, kReusePortPerLoop };
 
     TcpServer(EventLoop* loop, 
               const InetAddress& listenAddr, 
@@ -35,23 +40,93 @@ public:
     void setConnectionCallback(const ConnectionCallback& cb) { connectionCallback_ = cb; }
     void setMessageCallback(const MessageCallback& cb) { messageCallback_ = cb; }
     void setWriteCompleteCallback(const WriteCompleteCallback& cb) { writeCompleteCallback_ = cb; }
+    /* 
+        新连接使用边缘触发模式 需要在start之前设置
+        socket只注册一次EPOLLIN|EPOLLOUT|EPOLLRDHUP|EPOLLET 发送数据时不再修改关注的事件
+        使用io_uring时不支持 连接仍然是水平触发
+    */
+    void setEdgeTriggered(bool on) { edgeTriggered_ = on; }
+    /*
+        背压 连接的待发数据超过pauseAbove时自动停止读该连接 回落到resumeBelow及以下时恢复
+        慢速的对端不读回复 服务器也不再读它的请求 每个连接的内存有上限 需要在start之前设置
+    */
+    void setReadPauseThreshold(size_t pauseAbove, size_t resumeBelow) {
+        pauseReadAbove_ = pauseAbove;
+        resumeReadBelow_ = resumeBelow;
+    }
+    /*
+        空闲超时 超过seconds秒没有读写的连接会被强制关闭 0表示不启用 需要在start之前设置
+        每个subloop一个时间轮 不是每个连接一个定时器
+    */
+    void setIdleTimeout(int seconds) { idleTimeout_ = seconds; }
+    /*
+        每隔seconds秒 释放所有连接中没有数据的输入输出缓冲区 0表示不启用 需要在start之前设置
+        大量空闲长连接时 连接只在有数据收发时占用缓冲区的内存
+    */
+    void setBufferReleaseInterval(double seconds) { bufferReleaseInterval_ = seconds; }
+    /* listen的backlog 默认1024 需要在start之前设置 kReusePortPerLoop时对每个listenfd生效 */
+    void setListenBacklog(int backlog) { listenBacklog_ = backlog; }
+    /* 每次可读事件最多accept多少个连接 默认16 需要在start之前设置 */
+    void setMaxAcceptsPerRead(int maxAccepts) { maxAcceptsPerRead_ = maxAccepts; }
+    /* mainloop为新连接选择subloop的策略 默认轮询 需要在start之前设置 kReusePortPerLoop时不使用 */
+    void setLoadBalance(LoadBalancer::Strategy strategy);
     /* 设置subloop的数量 */
     void setThreadNum(int numThreads);
+    /* subloop线程绑定CPU 见EventLoopThreadPool 需要在start之前设置 */
+    void setCpuAffinity(const std::vector<int>& cpus);
+    void setAutoCpuAffinity(bool on);
     /* 启动服务器 */
     void start();
 private:
-    using ConnectionMap = std::unordered_map<std::string, TcpConnectionPtr>;
+    /* 节点从subloop的SlabPool中分配 */
+    using ConnectionMap = std::unordered_map<uint64_t, TcpConnectionPtr, std::hash<uint64_t>, std::equal_to<uint64_t>,
+                                             SlabAllocator<std::pair<const uint64_t, TcpConnectionPtr>>>;
+
+    /*
+        每个subloop的连接表 只在该loop线程中访问 不需要加锁
+        连接的建立和关闭都在自己的subloop中完成 关闭连接不经过mainloop
+    */
+    struct LoopShard {
+        explicit LoopShard(EventLoop* ioLoop) 
+            : loop(ioLoop)
+            , connections(ConnectionMap::allocator_type(ioLoop->slabPool()))
+            {
+        }
+        EventLoop* loop;
+        ConnectionMap connections;               /* 连接id => 连接 */
+        std::shared_ptr<TimingWheel> idleWheel;  /* 空闲超时的时间轮 为空表示不启用 */
+        std::unique_ptr<Acceptor> acceptor;      /* kReusePortPerLoop时该loop自己的listenfd */
+        TimerId bufferReleaseTimer;              /* 定期释放空闲缓冲区的定时器 */
+    };
+    using LoopShardPtr = std::shared_ptr<LoopShard>;
+    using LoopShardMap = std::unordered_map<EventLoop*, LoopShardPtr>;
 
     /* 连接相关 */
+    /* mainloop的acceptor收到新连接 选择一个subloop */
     void newConnection(int sockfd, const InetAddress& peerAddr);
-    void removeConnection(const TcpConnectionPtr& conn);
-    void removeConnectionInLoop(const TcpConnectionPtr& conn);
+    /* 把新连接交给ioLoop kReusePortPerLoop时由ioLoop自己的acceptor直接调用 */
+    void newConnectionOnLoop(EventLoop* ioLoop, int sockfd, const InetAddress& peerAddr);
+    /* 在subloop中创建TcpConnection并建立连接 */
+    void establishConnection(const LoopShardPtr& shard, int sockfd, const InetAddress& peerAddr, uint64_t connId);
+    /* 在subloop中关闭该loop的listenfd 销毁所有连接 */
+    static void destroyShard(const LoopShardPtr& shard);
+    /* 释放该loop所有连接的空闲缓冲区 */
+    static void releaseIdleBuffers(const std::weak_ptr<LoopShard>& weakShard);
+    /* 在ioLoop中创建并监听该loop自己的listenfd */
+    void startLoopAcceptor(const LoopShardPtr& shard);
+    /*
+        TcpConnection连接断开时 handleClose执行的回调 在连接所在的subloop中执行
+        只持有LoopShard的weak_ptr 不依赖TcpServer对象 TcpServer析构之后关闭的连接也是安全的
+    */
+    static void removeConnection(const std::weak_ptr<LoopShard>& weakShard, const TcpConnectionPtr& conn);
 
 /* 组件 */
     EventLoop* loop_; /* baseloop是由用户传入的 */
+    const InetAddress listenAddr_;
     const std::string ipPort_;
     const std::string name_;
-    std::unique_ptr<Acceptor> acceptor_; /* 运行在mainloop监听新连接 */
+    const Option option_;
+    std::unique_ptr<Acceptor> acceptor_; /* 运行在mainloop监听新连接 kReusePortPerLoop时为空 */
     std::shared_ptr<EventLoopThreadPool> threadPool_; /* one loop per thread */
 /* 回调 */
     ConnectionCallback connectionCallback_; /* 处理新连接用户的回调 */
@@ -60,9 +135,16 @@ private:
     ThreadInitCallback threadInitCallback_; /* 线程创建时对loop进行处理的回调 */
 
     std::atomic_int started_;
+    bool edgeTriggered_; /* 新连接是否使用边缘触发模式 */
+    size_t pauseReadAbove_;  /* 待发数据超过该值自动停止读 0表示不启用 */
+    size_t resumeReadBelow_; /* 待发数据回落到该值自动恢复读 */
+    int idleTimeout_;        /* 空闲超时的秒数 0表示不启用 */
+    double bufferReleaseInterval_; /* 释放空闲缓冲区的间隔秒数 0表示不启用 */
+    int listenBacklog_;      /* listen的backlog */
+    int maxAcceptsPerRead_;  /* 每次可读事件最多accept的连接数 */
 
-    int nextConnId_;
-    ConnectionMap connections_; /* 保存所有的连接 */
+    std::atomic<uint64_t> nextConnId_; /* 64位的连接id 不会重复 */
+    LoopShardMap shards_; /* subloop => 该loop的连接表 start之后只读 */
 };
 
 
@@ -0,0 +1,12 @@
+#include "Timer.hh"
+
+std::atomic_int64_t Timer::s_numCreated_{0};
+
+/* 重复定时器 从now开始重新计时 */
+void Timer::restart(Timestamp now) {
+    if (repeat_) {
+        expiration_ = addTime(now, interval_);
+    } else {
+        expiration_ = Timestamp::invalid();
+    }
+}
@@ -0,0 +1,50 @@
+#ifndef   __TIMER_HH_
+#define   __TIMER_HH_
+
+#include "../base/noncopyable.hh"
+#include "../base/Timestamp.hh"
+#include "Callbacks.hh"
+
+#include <atomic>
+
+/* Timer定时器类 记录一个定时任务的回调 到期时间 以及重复间隔 */
+class Timer : noncopyable {
+public:
+    Timer(TimerCallback cb, Timestamp when, double interval)
+        : callback_(std::move(cb))
+        , expiration_(when)
+        , interval_(interval)
+        , repeat_(interval > 0.0)
+        , sequence_(++ s_numCreated_)
+        , heapIndex_(-1)
+        {
+    }
+
+    /* 定时器到期 执行回调 */
+    void run() const { callback_(); }
+
+    Timestamp expiration() const { return expiration_; }
+    bool repeat() const { return repeat_; }
+    int64_t sequence() const { return sequence_; }
+
+    /* 重复定时器 从now开始重新计时 */
+    void restart(Timestamp now);
+
+    /* 在TimerQueue最小堆中的下标 -1表示不在堆中 */
+    int heapIndex() const { return heapIndex_; }
+    void setHeapIndex(int idx) { heapIndex_ = idx; }
+
+    static int64_t numCreated() { return s_numCreated_; }
+private:
+    const TimerCallback callback_; /* 定时器回调 */
+    Timestamp expiration_;         /* 到期时间 */
+    const double interval_;        /* 重复间隔(秒) 一次性定时器为0 */
+    const bool repeat_;            /* 是否重复 */
+    const int64_t sequence_;       /* 全局唯一序号 用于识别TimerId */
+    int heapIndex_;
+
+    static std::atomic_int64_t s_numCreated_;
+};
+
+
+#endif // __TIMER_HH_
@@ -0,0 +1,22 @@
+#ifndef   __TIMERID_HH_
+#define   __TIMERID_HH_
+
+#include <stdint.h>
+
+/* 
+    TimerId定时器标识 由EventLoop::runAt/runAfter/runEvery返回 用于取消定时器
+    只保存Timer的全局序号 取消时由TimerQueue按序号查找
+    即使定时器已经到期被释放 也能安全地取消(什么都不做)
+*/
+class TimerId {
+public:
+    TimerId() : sequence_(0) {}
+    explicit TimerId(int64_t seq) : sequence_(seq) {}
+
+    int64_t sequence() const { return sequence_; }
+private:
+    int64_t sequence_;
+};
+
+
+#endif // __TIMERID_HH_
@@ -0,0 +1,227 @@
+#include "TimerQueue.hh"
+#include "../base/Logger.hh"
+#include "EventLoop.hh"
+#include "Timer.hh"
+
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+
+
+/* 创建timerfd 使用单调时钟 不受系统时间调整的影响 */
+static int createTimerfd() {
+    int timerfd = ::timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (timerfd < 0) {
+        LOG_FATAL("timerfd_create error:%d \n", errno);
+    }
+    return timerfd;
+}
+
+/* 单调时钟的时间when转为timespec 用作timerfd的绝对到期时间 不需要读取当前时间 */
+static struct timespec toTimespec(Timestamp when) {
+    int64_t microseconds = when.microSecondsSinceEpoch();
+    if (microseconds <= 0) {
+        /* 为0时timerfd被解除 */
+        microseconds = 1;
+    }
+    struct timespec ts;
+    ts.tv_sec = static_cast<time_t>(microseconds / Timestamp::kMicroSecondsPerSecond);
+    ts.tv_nsec = static_cast<long>((microseconds % Timestamp::kMicroSecondsPerSecond) * 1000);
+    return ts;
+}
+
+/* 读走timerfd上的到期次数 否则会一直触发可读事件 */
+static void readTimerfd(int timerfd) {
+    uint64_t howmany;
+    ssize_t n = ::read(timerfd, &howmany, sizeof(howmany));
+    if (n != sizeof(howmany)) {
+        LOG_ERROR("TimerQueue::handleRead() reads %zd bytes instead of 8 \n", n);
+    }
+}
+
+/* 堆中元素的顺序 先按到期时间 再按序号 */
+static bool earlier(const Timer* lhs, const Timer* rhs) {
+    if (lhs->expiration() == rhs->expiration()) {
+        return lhs->sequence() < rhs->sequence();
+    }
+    return lhs->expiration() < rhs->expiration();
+}
+
+
+TimerQueue::TimerQueue(EventLoop* loop)
+    : loop_(loop)
+    , timerfd_(createTimerfd())
+    , timerfdChannel_(loop, timerfd_)
+    {
+        timerfdChannel_.setReadCallback(std::bind(&TimerQueue::handleRead, this));
+        /* timerfd一直处于监听状态 是否触发由timerfd_settime控制 */
+        timerfdChannel_.enableReading();
+}
+
+TimerQueue::~TimerQueue() {
+    timerfdChannel_.disableAll();
+    timerfdChannel_.remove();
+    ::close(timerfd_);
+    /* 释放所有未到期的定时器 */
+    for (auto& item : timers_) {
+        delete item.second;
+    }
+}
+
+
+/* 添加定时器 线程安全 可以在其他线程中调用 */
+TimerId TimerQueue::addTimer(TimerCallback cb, Timestamp when, double interval) {
+    Timer* timer = new Timer(std::move(cb), when, interval);
+    /* 先取出序号 交给loop线程后timer可能随时到期被释放 */
+    TimerId timerId(timer->sequence());
+    /* 定时器只能在loop线程中操作 */
+    loop_->runInLoop(std::bind(&TimerQueue::addTimerInLoop, this, timer));
+    return timerId;
+}
+
+/* 取消定时器 线程安全 */
+void TimerQueue::cancel(TimerId timerId) {
+    loop_->runInLoop(std::bind(&TimerQueue::cancelInLoop, this, timerId));
+}
+
+void TimerQueue::addTimerInLoop(Timer* timer) {
+    timers_[timer->sequence()] = timer;
+    heapPush(timer);
+    /* 新定时器成为最早到期的定时器 需要重设timerfd */
+    if (heap_[0] == timer) {
+        resetTimerfd(timer->expiration());
+    }
+}
+
+void TimerQueue::cancelInLoop(TimerId timerId) {
+    auto it = timers_.find(timerId.sequence());
+    if (it == timers_.end()) {
+        /* 定时器已经到期释放 或者已经被取消了 */
+        return;
+    }
+    Timer* timer = it->second;
+    timers_.erase(it);
+    if (timer->heapIndex() >= 0) {
+        /* 还在堆中 直接删除 */
+        heapRemove(timer);
+        delete timer;
+    }
+    /*
+        不在堆中 说明定时器正在执行回调(在回调中取消自己或其他到期的定时器)
+        已经从timers_中删除 reset()时就不会再加入堆中 由reset()释放
+    */
+}
+
+/* timerfd可读 说明有定时器到期了 */
+void TimerQueue::handleRead() {
+    /* 使用本轮循环缓存的时间 */
+    Timestamp now(loop_->monotonicNow());
+    readTimerfd(timerfd_);
+
+    /* 取出所有到期的定时器 */
+    std::vector<Timer*> expired;
+    while (!heap_.empty() && !(now < heap_[0]->expiration())) {
+        Timer* timer = heap_[0];
+        heapRemove(timer);
+        expired.push_back(timer);
+    }
+
+    for (Timer* timer : expired) {
+        /* 可能已经被前面执行的回调取消了 */
+        if (timers_.find(timer->sequence()) != timers_.end()) {
+            timer->run();
+        }
+    }
+
+    reset(expired, now);
+}
+
+/* 处理完到期的定时器后 重新加入重复的定时器 并重设timerfd */
+void TimerQueue::reset(const std::vector<Timer*>& expired, Timestamp now) {
+    for (Timer* timer : expired) {
+        auto it = timers_.find(timer->sequence());
+        if (timer->repeat() && it != timers_.end()) {
+            /* 重复定时器 且在回调中没有被取消 */
+            timer->restart(now);
+            heapPush(timer);
+        } else {
+            if (it != timers_.end()) {
+                timers_.erase(it);
+            }
+            delete timer;
+        }
+    }
+    if (!heap_.empty()) {
+        resetTimerfd(heap_[0]->expiration());
+    }
+}
+
+/* 把timerfd设置为最早到期定时器的到期时间 */
+void TimerQueue::resetTimerfd(Timestamp expiration) {
+    struct itimerspec newValue;
+    struct itimerspec oldValue;
+    bzero(&newValue, sizeof(newValue));
+    bzero(&oldValue, sizeof(oldValue));
+    /* 绝对时间 已经过去的时刻会立即触发 */
+    newValue.it_value = toTimespec(expiration);
+    if (::timerfd_settime(timerfd_, TFD_TIMER_ABSTIME, &newValue, &oldValue) < 0) {
+        LOG_ERROR("timerfd_settime error:%d \n", errno);
+    }
+}
+
+
+/* 最小堆操作 */
+void TimerQueue::heapSet(size_t idx, Timer* timer) {
+    heap_[idx] = timer;
+    timer->setHeapIndex(static_cast<int>(idx));
+}
+
+void TimerQueue::heapPush(Timer* timer) {
+    heap_.push_back(timer);
+    timer->setHeapIndex(static_cast<int>(heap_.size() - 1));
+    siftUp(heap_.size() - 1);
+}
+
+/* 从堆的任意位置删除 用最后一个元素填补空位再调整 */
+void TimerQueue::heapRemove(Timer* timer) {
+    size_t idx = static_cast<size_t>(timer->heapIndex());
+    Timer* last = heap_.back();
+    heap_.pop_back();
+    timer->setHeapIndex(-1);
+    if (idx < heap_.size()) {
+        heapSet(idx, last);
+        siftUp(idx);
+        siftDown(static_cast<size_t>(last->heapIndex()));
+    }
+}
+
+void TimerQueue::siftUp(size_t idx) {
+    Timer* timer = heap_[idx];
+    while (idx > 0) {
+        size_t parent = (idx - 1) / 2;
+        if (!earlier(timer, heap_[parent])) {
+            break;
+        }
+        heapSet(idx, heap_[parent]);
+        idx = parent;
+    }
+    heapSet(idx, timer);
+}
+
+void TimerQueue::siftDown(size_t idx) {
+    Timer* timer = heap_[idx];
+    size_t n = heap_.size();
+    while (2 * idx + 1 < n) {
+        size_t child = 2 * idx + 1;
+        if (child + 1 < n && earlier(heap_[child + 1], heap_[child])) {
+            ++ child;
+        }
+        if (!earlier(heap_[child], timer)) {
+            break;
+        }
+        heapSet(idx, heap_[child]);
+        idx = child;
+    }
+    heapSet(idx, timer);
+}
@@ -0,0 +1,70 @@
+#ifndef   __TIMERQUEUE_HH_
+#define   __TIMERQUEUE_HH_
+
+#include "../base/noncopyable.hh"
+#include "../base/Timestamp.hh"
+#include "Callbacks.hh"
+#include "Channel.hh"
+#include "TimerId.hh"
+
+#include <vector>
+#include <unordered_map>
+
+class EventLoop;
+class Timer;
+
+/*
+    TimerQueue定时器队列 每个EventLoop拥有一个
+    所有定时器共用一个timerfd 封装为Channel注册到EventLoop的Poller上
+    timerfd总是设置为最早到期的定时器的到期时间 到期后在loop线程中执行回调
+    到期时间都是单调时钟(CLOCK_MONOTONIC)的时间 系统时间的调整不会让定时器提前或推迟
+
+    定时器使用最小堆组织(按到期时间 序号排序)
+        添加 / 取消定时器 O(logn)
+        取得最早到期的定时器 O(1)
+    Timer记录了自己在堆中的下标 取消时可以直接从堆中间删除 不需要遍历
+    另外用序号到Timer的哈希表记录所有未到期的定时器 用于TimerId的查找
+*/
+class TimerQueue : noncopyable {
+public:
+    explicit TimerQueue(EventLoop* loop);
+    ~TimerQueue();
+
+    /* 添加定时器 线程安全 可以在其他线程中调用 */
+    TimerId addTimer(TimerCallback cb, Timestamp when, double interval);
+    /* 取消定时器 线程安全 */
+    void cancel(TimerId timerId);
+
+    /* 未到期的定时器数量 */
+    size_t size() const { return heap_.size(); }
+private:
+    using TimerHeap = std::vector<Timer*>;
+    using TimerMap = std::unordered_map<int64_t, Timer*>;
+
+    /* 在loop线程中添加 / 取消定时器 */
+    void addTimerInLoop(Timer* timer);
+    void cancelInLoop(TimerId timerId);
+    /* timerfd可读 说明有定时器到期了 */
+    void handleRead();
+    /* 处理完到期的定时器后 重新加入重复的定时器 并重设timerfd */
+    void reset(const std::vector<Timer*>& expired, Timestamp now);
+    /* 把timerfd设置为最早到期定时器的到期时间 */
+    void resetTimerfd(Timestamp expiration);
+
+    /* 最小堆操作 */
+    void heapPush(Timer* timer);
+    void heapRemove(Timer* timer);
+    void siftUp(size_t idx);
+    void siftDown(size_t idx);
+    void heapSet(size_t idx, Timer* timer);
+
+    EventLoop* loop_;
+    const int timerfd_;
+    Channel timerfdChannel_;
+
+    TimerHeap heap_;   /* 按到期时间组织的最小堆 */
+    TimerMap timers_;  /* 序号 => 定时器 包括正在执行回调的定时器 */
+};
+
+
+#endif // __TIMERQUEUE_HH_
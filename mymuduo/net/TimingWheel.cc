@@ -0,0 +1,58 @@
+#include "TimingWheel.hh"
+#include "EventLoop.hh"
+#include "TcpConnection.hh"
+
+
+TimingWheel::TimingWheel(EventLoop* loop, int timeoutSeconds)
+    : loop_(loop)
+    , timeout_(static_cast<uint64_t>(timeoutSeconds) + 1)
+    , tick_(0)
+    , buckets_(static_cast<size_t>(timeoutSeconds) + 2)
+    {
+}
+
+TimingWheel::~TimingWheel() = default;
+
+/* 开始转动 在loop线程中调用 */
+void TimingWheel::start() {
+    /* 时间轮可能先于loop销毁(TcpServer析构) 定时器只持有weak_ptr */
+    std::weak_ptr<TimingWheel> weakWheel(shared_from_this());
+    timer_ = loop_->runEvery(1.0, [weakWheel]() {
+        std::shared_ptr<TimingWheel> wheel(weakWheel.lock());
+        if (wheel) {
+            wheel->onTick();
+        }
+    });
+}
+
+/* 停止转动 时间轮销毁之后定时器不再每秒触发 */
+void TimingWheel::stop() {
+    loop_->cancel(timer_);
+}
+
+/* 加入新连接 放入超时时刻对应的桶中 */
+void TimingWheel::add(const TcpConnectionPtr& conn) {
+    buckets_[(tick_ + timeout_) % buckets_.size()].push_back(conn);
+}
+
+/* 每秒转动一格 处理转到的桶 */
+void TimingWheel::onTick() {
+    ++ tick_;
+    expiring_.swap(buckets_[tick_ % buckets_.size()]);
+    for (const std::weak_ptr<TcpConnection>& weakConn : expiring_) {
+        TcpConnectionPtr conn(weakConn.lock());
+        if (!conn || conn->disconnected()) {
+            /* 连接已经关闭 */
+            continue;
+        }
+        uint64_t deadline = conn->lastActiveTick() + timeout_;
+        if (deadline <= tick_) {
+            /* 超时 强制关闭 */
+            conn->forceClose();
+        } else {
+            /* 期间有过读写 放入新的超时时刻对应的桶中 deadline - tick_ <= timeout_ 不会是当前的桶 */
+            buckets_[deadline % buckets_.size()].push_back(weakConn);
+        }
+    }
+    expiring_.clear();
+}
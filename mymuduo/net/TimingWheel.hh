@@ -0,0 +1,58 @@
+#ifndef   __TIMINGWHEEL_HH_
+#define   __TIMINGWHEEL_HH_
+
+#include "../base/noncopyable.hh"
+#include "Callbacks.hh"
+#include "TimerId.hh"
+
+#include <vector>
+#include <memory>
+#include <stdint.h>
+
+class EventLoop;
+
+/*
+    TimingWheel 时间轮 用于关闭空闲连接 每个subloop一个 只在loop线程中使用
+
+    轮上有timeout + 2个桶 每秒转动一格(tick)
+    tick只有1秒的精度 超时按timeout + 1个tick计算 连接在没有读写timeout到timeout + 1秒之后关闭
+    连接建立时放入 当前tick + timeout + 1 对应的桶中
+    连接有读写时只记录最后活跃的tick(TcpConnection::lastActiveTick_) O(1) 不移动桶
+    转到某个桶时 检查桶中的每个连接:
+        最后活跃时间 + timeout <= 当前tick 超时 强制关闭
+        否则按最后活跃时间重新放入对应的桶中(懒惰地移动)
+
+    每个连接的开销: 桶中的一个weak_ptr 和TcpConnection中的lastActiveTick_ 以及指向时间轮的指针
+    没有每个连接一个的定时器
+*/
+class TimingWheel : noncopyable, public std::enable_shared_from_this<TimingWheel> {
+public:
+    TimingWheel(EventLoop* loop, int timeoutSeconds);
+    ~TimingWheel();
+
+    /* 开始转动 在loop线程中调用 */
+    void start();
+    /* 停止转动 取消定时器 在loop线程中调用 */
+    void stop();
+
+    /* 当前的tick 连接活跃时记录该值 */
+    uint64_t now() const { return tick_; }
+    /* 加入新连接 在loop线程中调用 */
+    void add(const TcpConnectionPtr& conn);
+
+private:
+    using WeakConnectionList = std::vector<std::weak_ptr<TcpConnection>>;
+
+    /* 每秒转动一格 处理转到的桶 */
+    void onTick();
+
+    EventLoop* loop_;
+    const uint64_t timeout_;             /* 超时的tick数 timeoutSeconds + 1 */
+    uint64_t tick_;                      /* 当前的tick */
+    TimerId timer_;                      /* 每秒转动一格的定时器 */
+    std::vector<WeakConnectionList> buckets_;
+    WeakConnectionList expiring_;        /* onTick正在处理的桶 复用内存 */
+};
+
+
+#endif // __TIMINGWHEEL_HH_
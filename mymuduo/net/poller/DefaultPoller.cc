@@ -1,14 +1,23 @@
 #include "../Poller.hh"
+#include "../../base/Logger.hh"
 #include "EPollPoller.hh"
+#include "IoUringPoller.hh"
 
 #include <stdlib.h>
 
 /* EventLoop可以通过该接口获得默认IO复用的具体实现 */
 Poller* Poller::newDefaultPoller(EventLoop* loop) {
-    /* 默认提供epoll的实例 如果环境变量中有MUDUO_USE_POLL则返回poll的实例 */
-    if (::getenv("MUDUO_USE_POLL")) {
-        return nullptr; // add code 生成poll的实例
-    } else {
-        return new EPollPoller(loop);
+    /* 
+        默认提供epoll的实例 
+        如果环境变量中有MUDUO_USE_IOURING则返回io_uring的实例 内核不支持时回退到epoll
+    */
+    if (::getenv("MUDUO_USE_IOURING")) {
+        IoUringPoller* poller = new IoUringPoller(loop);
+        if (poller->valid()) {
+            return poller;
+        }
+        delete poller;
+        LOG_ERROR("Poller::newDefaultPoller io_uring unavailable, fall back to epoll \n");
     }
+    return new EPollPoller(loop);
 }
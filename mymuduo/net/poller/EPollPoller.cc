@@ -5,11 +5,12 @@
 #include <errno.h>
 #include <string.h>
 #include <unistd.h>
+#include <algorithm>
 
 /* Channel::index_为下面三种状态之一 */
 const int kNew = -1;    /* Channel没添加到EPollPoller */
-const int kAdded = 1;   /* Channel已添加到EPollPoller */
-const int kDelete = 2;  /* Channel已从EPollPoller中删除 只是从监听树上取下 仍然在哈希表中 */
+const int kAdded = 1;   /* Channel已添加到EPollPoller 在监听树上 */
+const int kDelete = 2;  /* Channel不在监听树上(已经取下或者还没有上树) 仍然在channels_中 */
 
 
 /* 构造和析构 */
@@ -17,6 +18,8 @@ EPollPoller::EPollPoller(EventLoop* loop)
     : Poller(loop) 
     , epollfd_(::epoll_create1(EPOLL_CLOEXEC)) /* 创建一个epollfd */
     , events_(kInitEventListSize) /* events_初始大小16 */
+    , ctlCalls_(0)
+    , savedCtlCalls_(0)
     { 
         if (epollfd_ < 0) {
             LOG_FATAL("epoll_create1 error: %d \n", errno);
@@ -26,61 +29,116 @@ EPollPoller::~EPollPoller() {
     ::close(epollfd_);
 }
 
-/* 更新Channel在Poller中的状态 使用私有方法update() */
+/* 
+    更新Channel在Poller中的状态
+    这里并不立即调用epoll_ctl 只是把fd记录到dirtyFds_中
+    同一轮循环中对同一个fd的多次修改(比如enableWriting之后很快又disableWriting)会合并
+    在下一次epoll_wait之前由flushUpdates()统一比较内核中注册的事件和当前要关注的事件
+    相同就不需要调用epoll_ctl
+*/
 void EPollPoller::updateChannel(Channel* channel) {
     /* 获得Channel在Poller中的状态 */
     const int index = channel->index();
-    LOG_INFO("func=%s => fd=%d events=%d index=%d \n", __FUNCTION__, channel->fd(), channel->events(), index);
-    /* 没添加到监听树或从监听树上取下的Channel */
-    if (index == kNew || index == kDelete) {
-        if (index == kNew) {
-            /* 新添加到监听树上的Channel */
-            int fd = channel->fd();
-            channels_[fd] = channel;
-        }
-        /* 更新状态 */
-        channel->set_index(kAdded);
-        /* 使用epoll_ctl函数的EPOLL_CTL_ADD操作将Channel添加到监听树 */
-        update(EPOLL_CTL_ADD, channel);
-    } else {
-        /* 还在监听树上的Channel */
-        if (channel->isNoneEvent()) {
-            /* 如果该Channel没有要监听的事件 就把他从监听树上取下 */
-            update(EPOLL_CTL_DEL, channel);
-            channel->set_index(kDelete);
-            /* 
-                注意 如果Channel上没有要监听的事件 把他从监听树上取下 
-                但并不会从哈希表中删除 如果以后有要监听的事件会再上树 
-            */
-        } else {
-            /* 监听的事件改变了 就修改要监听的事件 */
-            update(EPOLL_CTL_MOD, channel);
-        }
+    const int fd = channel->fd();
+    LOG_INFO("func=%s => fd=%d events=%d index=%d \n", __FUNCTION__, fd, channel->events(), index);
+    if (index == kNew) {
+        /* 新添加的Channel 先记录下来 还没有上树 */
+        addToChannels(fd, channel);
+        channel->set_index(kDelete);
+    }
+    FdState& state = stateOf(fd);
+    ++ state.pendingUpdates;
+    if (!state.dirty) {
+        state.dirty = true;
+        dirtyFds_.push_back(fd);
     }
 }
 
 /* 把Channel从Poller中删除 */
 void EPollPoller::removeChannel(Channel* channel) {
     int fd = channel->fd();
-    channels_.erase(fd);
+    removeFromChannels(fd);
  
     LOG_INFO("func=%s => fd=%d \n", __FUNCTION__, fd);
 
+    /* 还没有生效的修改直接丢弃 dirtyFds_中的fd在flushUpdates()中会被跳过 */
+    FdState& state = stateOf(fd);
+    savedCtlCalls_ += state.pendingUpdates;
+    state.pendingUpdates = 0;
+    state.dirty = false;
+
     int index = channel->index();
     if (index == kAdded) {
-        /* 如果Channel还在监听树上 把它取下 */
+        /* 
+            如果Channel还在监听树上 立即把它取下
+            删除之后fd马上就会被close 之后可能被新连接复用 不能推迟
+        */
         update(EPOLL_CTL_DEL, channel);
     }
-    /* 如果已经从监听树上取下(kDelete) 无需再取下 */
+    /* 如果不在监听树上(kDelete) 无需再取下 */
     channel->set_index(kNew);
 }
 
+/* 在epoll_wait之前 统一提交本轮循环中对关注事件的修改 */
+void EPollPoller::flushUpdates() {
+    for (int fd : dirtyFds_) {
+        FdState& state = stateOf(fd);
+        if (!state.dirty) {
+            /* 已经被removeChannel删除了 */
+            continue;
+        }
+        state.dirty = false;
+        Channel* channel = findChannel(fd);
+        /* 最多只需要一次epoll_ctl */
+        savedCtlCalls_ += state.pendingUpdates - 1;
+        state.pendingUpdates = 0;
+
+        const int wanted = channel->isNoneEvent() ? 0 : channel->pollEvents();
+        if (channel->index() == kAdded) {
+            /* 还在监听树上的Channel */
+            if (wanted == 0) {
+                /* 如果该Channel没有要监听的事件 就把他从监听树上取下 */
+                update(EPOLL_CTL_DEL, channel);
+                channel->set_index(kDelete);
+                /* 
+                    注意 如果Channel上没有要监听的事件 把他从监听树上取下 
+                    但并不会从channels_中删除 如果以后有要监听的事件会再上树 
+                */
+            } else if (wanted != state.events) {
+                /* 监听的事件改变了 就修改要监听的事件 */
+                update(EPOLL_CTL_MOD, channel);
+            } else {
+                /* 和内核中注册的事件相同 */
+                ++ savedCtlCalls_;
+            }
+        } else {
+            /* 没添加到监听树或从监听树上取下的Channel */
+            if (wanted != 0) {
+                /* 使用epoll_ctl函数的EPOLL_CTL_ADD操作将Channel添加到监听树 */
+                update(EPOLL_CTL_ADD, channel);
+                channel->set_index(kAdded);
+            } else {
+                ++ savedCtlCalls_;
+            }
+        }
+        state.events = wanted;
+    }
+    dirtyFds_.clear();
+}
+
+EPollPoller::FdState& EPollPoller::stateOf(int fd) {
+    if (static_cast<size_t>(fd) >= fdStates_.size()) {
+        fdStates_.resize(std::max(static_cast<size_t>(fd) + 1, fdStates_.size() * 2));
+    }
+    return fdStates_[fd];
+}
+
 /* epoll_ctl add/mod/del */
 void EPollPoller::update(int operation, Channel* channel) {
     epoll_event event;
     bzero(&event, sizeof(event));
     int fd = channel->fd();
-    event.events = channel->events();
+    event.events = channel->pollEvents(); /* 边缘触发模式下和events()不同 */
     // event.data.fd = fd;
     /* 
         注意 epoll_event.data中fd和ptr不能同时使用 
@@ -88,6 +146,7 @@ void EPollPoller::update(int operation, Channel* channel) {
         妈的这个把我坑惨了
     */
     event.data.ptr = static_cast<void*>(channel); /* 携带了一个参数 */
+    ++ ctlCalls_;
     /* 调用epoll_ctl执行operation对应的操作 */
     if (::epoll_ctl(epollfd_, operation, fd, &event) < 0) {
         if (operation == EPOLL_CTL_DEL) {
@@ -102,9 +161,12 @@ void EPollPoller::update(int operation, Channel* channel) {
 
 
 /* epoll_wait的封装 将发生事件的Channel通过activeChannels参数告知EventLoop */
-Timestamp EPollPoller::poll(int timeoutMs, Poller::ChannelList* activeChannels) {
+void EPollPoller::poll(int timeoutMs, Poller::ChannelList* activeChannels) {
     /* 应该用LOG_DEBUG更合理些 */
-    LOG_INFO("func=%s => fd total count:%zd\n", __FUNCTION__, channels_.size());
+    LOG_INFO("func=%s => fd total count:%zd\n", __FUNCTION__, numChannels());
+
+    /* 提交本轮循环中对关注事件的修改 */
+    flushUpdates();
 
     int numEvents = ::epoll_wait(epollfd_, 
                                  &*events_.begin(), /* 用成员变量events_接收发生的监听事件 */
@@ -113,9 +175,6 @@ Timestamp EPollPoller::poll(int timeoutMs, Poller::ChannelList* activeChannels)
     /* errno是全局的变量 多个线程的poll都有可能访问它 所以先存起来 */
     int saveErrno = errno;
 
-    /* 记录当前时间 */
-    Timestamp now(Timestamp::now());
-
     if (numEvents > 0) {
         /* 有发生事件的fd */
         LOG_INFO("func=%s => %d events happened\n", __FUNCTION__, numEvents);
@@ -137,7 +196,6 @@ Timestamp EPollPoller::poll(int timeoutMs, Poller::ChannelList* activeChannels)
             LOG_ERROR("func=%s => epoll_wait error\n", __FUNCTION__);
         }
     }
-    return now;
 }
 
 /* 将发生监听事件的Channel填入activeChannels中 以便EventLoop进行处理 */
@@ -2,7 +2,6 @@
 #define   __EPOLLPOLLER_HH_
 
 #include "../Poller.hh"
-#include "../../base/Timestamp.hh"
 
 #include <sys/epoll.h>
 #include <vector>
@@ -16,9 +15,15 @@ public:
     ~EPollPoller() override; /* override确认这是一个覆盖 */
 
     /* epoll方法接口 */
-    Timestamp poll(int timeoutMs, Poller::ChannelList* activeChannels) override;
+    void poll(int timeoutMs, Poller::ChannelList* activeChannels) override;
     void updateChannel(Channel* channel) override; /* epoll_ctl add */
     void removeChannel(Channel* channel) override; /* epoll_ctl del */
+
+    /* 实际调用epoll_ctl的次数 以及合并修改省掉的次数 */
+    uint64_t ctlCalls() const override { return ctlCalls_; }
+    uint64_t savedCtlCalls() const override { return savedCtlCalls_; }
+    /* 按Channel::pollEvents()注册 支持EPOLLET */
+    bool supportsEdgeTriggered() const override { return true; }
 private:
     static const int kInitEventListSize = 16;  /* EventList初始化大小 */
 
@@ -26,11 +31,27 @@ private:
     void fillActiaveChannels(int numEvents, Poller::ChannelList* activeChannels) const;
     /* epoll_ctl add/mod/del */
     void update(int operation, Channel* channel); /* epoll_ctl */
+    /* 在epoll_wait之前 统一提交本轮循环中对关注事件的修改 */
+    void flushUpdates();
+
+    /* 每个fd在内核中的注册状态 */
+    struct FdState {
+        FdState() : events(0), dirty(false), pendingUpdates(0) {}
+        int events;              /* 内核中注册的事件 */
+        bool dirty;              /* 是否在dirtyFds_中 */
+        uint32_t pendingUpdates; /* 上次提交之后updateChannel的次数 */
+    };
+    FdState& stateOf(int fd);
 
     using EventList = std::vector<epoll_event>;
 
     int epollfd_;       /* epoll文件系统的描述符 */
     EventList events_;  /* 用于接收发生事件的epoll_event 用作epoll_wait的传出参数 */
+
+    std::vector<FdState> fdStates_; /* 下标为fd */
+    std::vector<int> dirtyFds_;     /* 本轮循环中修改过关注事件的fd */
+    uint64_t ctlCalls_;
+    uint64_t savedCtlCalls_;
 };
 
 
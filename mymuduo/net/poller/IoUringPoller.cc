@@ -0,0 +1,309 @@
+#include "IoUringPoller.hh"
+#include "../../base/Logger.hh"
+#include "../Channel.hh"
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/epoll.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+
+/* Channel::index_为下面两种状态之一 */
+static const int kNew = -1;    /* Channel没添加到IoUringPoller */
+static const int kAdded = 1;   /* Channel已添加到IoUringPoller */
+
+/* POLL_REMOVE请求的user_data 它的完成事件直接忽略 */
+static const uint64_t kRemoveUserData = ~0ULL;
+
+/* POLL_ADD请求的user_data 高32位是版本号 低32位是fd */
+static uint64_t encodeUserData(int fd, uint32_t generation) {
+    return (static_cast<uint64_t>(generation) << 32) | static_cast<uint32_t>(fd);
+}
+
+/* 内核与用户态共享的环形队列下标 需要使用acquire/release语义读写 */
+static unsigned loadAcquire(const unsigned* p) { return __atomic_load_n(p, __ATOMIC_ACQUIRE); }
+static void storeRelease(unsigned* p, unsigned v) { __atomic_store_n(p, v, __ATOMIC_RELEASE); }
+
+
+/* 构造和析构 */
+IoUringPoller::IoUringPoller(EventLoop* loop)
+    : Poller(loop)
+    , ringFd_(-1)
+    , sqEntries_(0)
+    , sqRing_(MAP_FAILED)
+    , sqRingSize_(0)
+    , sqHead_(nullptr)
+    , sqTail_(nullptr)
+    , sqMask_(nullptr)
+    , sqArray_(nullptr)
+    , sqes_(nullptr)
+    , sqesSize_(0)
+    , cqRing_(MAP_FAILED)
+    , cqRingSize_(0)
+    , cqHead_(nullptr)
+    , cqTail_(nullptr)
+    , cqMask_(nullptr)
+    , cqes_(nullptr)
+    {
+        if (!setupRing()) {
+            /* 不支持io_uring不是错误 由newDefaultPoller回退到epoll */
+            LOG_ERROR("io_uring is not supported by the kernel, errno:%d \n", errno);
+        }
+}
+
+IoUringPoller::~IoUringPoller() {
+    if (sqes_ != nullptr) {
+        ::munmap(sqes_, sqesSize_);
+    }
+    if (cqRing_ != MAP_FAILED && cqRing_ != sqRing_) {
+        ::munmap(cqRing_, cqRingSize_);
+    }
+    if (sqRing_ != MAP_FAILED) {
+        ::munmap(sqRing_, sqRingSize_);
+    }
+    if (ringFd_ >= 0) {
+        ::close(ringFd_);
+    }
+}
+
+/* 建立io_uring 映射SQ CQ和SQE数组 */
+bool IoUringPoller::setupRing() {
+    io_uring_params params;
+    bzero(&params, sizeof(params));
+    int fd = static_cast<int>(::syscall(__NR_io_uring_setup, kRingEntries, &params));
+    if (fd < 0) {
+        return false;
+    }
+    /* 需要单次mmap(5.4) 完成事件不丢失(5.5) io_uring_enter带超时参数(5.11) */
+    const unsigned required = IORING_FEAT_SINGLE_MMAP | IORING_FEAT_NODROP | IORING_FEAT_EXT_ARG;
+    if ((params.features & required) != required) {
+        ::close(fd);
+        errno = ENOSYS;
+        return false;
+    }
+
+    sqRingSize_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cqRingSize_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    /* SQ和CQ在同一次映射中 */
+    sqRingSize_ = std::max(sqRingSize_, cqRingSize_);
+    cqRingSize_ = sqRingSize_;
+    sqRing_ = ::mmap(nullptr, sqRingSize_, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (sqRing_ == MAP_FAILED) {
+        ::close(fd);
+        return false;
+    }
+    cqRing_ = sqRing_;
+
+    sqesSize_ = params.sq_entries * sizeof(io_uring_sqe);
+    void* sqes = ::mmap(nullptr, sqesSize_, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+        ::close(fd);
+        return false;
+    }
+    sqes_ = static_cast<io_uring_sqe*>(sqes);
+
+    char* sq = static_cast<char*>(sqRing_);
+    sqHead_ = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    sqTail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sqMask_ = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    sqArray_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    char* cq = static_cast<char*>(cqRing_);
+    cqHead_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cqTail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cqMask_ = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+    sqEntries_ = params.sq_entries;
+    ringFd_ = fd;
+    return true;
+}
+
+/*
+    取一个空闲的SQE SQ满时先提交
+    提交失败时SQ仍然是满的 必须等内核取走请求之后才能复用SQE 否则会覆盖还没提交的请求
+*/
+io_uring_sqe* IoUringPoller::getSqe() {
+    unsigned tail = *sqTail_;
+    while (tail - loadAcquire(sqHead_) >= sqEntries_) {
+        /* SQ已满 先把已有的请求提交给内核 */
+        if (enter(0, 0) < 0) {
+            int saveErrno = errno;
+            if (saveErrno == EBUSY || saveErrno == EAGAIN) {
+                /* CQ溢出 取出完成事件腾出空间后重试 */
+                stashCompletions();
+            } else if (saveErrno != EINTR) {
+                LOG_FATAL("IoUringPoller::getSqe io_uring_enter error:%d \n", saveErrno);
+            }
+        }
+    }
+    unsigned idx = tail & *sqMask_;
+    io_uring_sqe* sqe = &sqes_[idx];
+    bzero(sqe, sizeof(*sqe));
+    sqArray_[idx] = idx;
+    storeRelease(sqTail_, tail + 1);
+    return sqe;
+}
+
+/* 提交SQ中的请求 并等待至少minComplete个完成事件 超时返回-1 errno为ETIME */
+int IoUringPoller::enter(unsigned minComplete, int timeoutMs) {
+    unsigned toSubmit = *sqTail_ - loadAcquire(sqHead_);
+    unsigned flags = 0;
+    io_uring_getevents_arg arg;
+    __kernel_timespec ts;
+    bzero(&arg, sizeof(arg));
+    if (minComplete > 0) {
+        flags |= IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG;
+        if (timeoutMs >= 0) {
+            ts.tv_sec = timeoutMs / 1000;
+            ts.tv_nsec = static_cast<long long>(timeoutMs % 1000) * 1000 * 1000;
+            arg.ts = reinterpret_cast<uint64_t>(&ts);
+        }
+    }
+    return static_cast<int>(::syscall(__NR_io_uring_enter, ringFd_, toSubmit, minComplete,
+                                      flags, minComplete > 0 ? &arg : nullptr, sizeof(arg)));
+}
+
+IoUringPoller::PollState& IoUringPoller::stateOf(int fd) {
+    if (static_cast<size_t>(fd) >= states_.size()) {
+        states_.resize(fd + 1);
+    }
+    return states_[fd];
+}
+
+/* 为channel提交POLL_ADD 关注channel当前的事件 */
+void IoUringPoller::arm(Channel* channel) {
+    PollState& state = stateOf(channel->fd());
+    ++ state.generation;
+    state.armed = true;
+    state.armedEvents = channel->events();
+
+    io_uring_sqe* sqe = getSqe();
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = channel->fd();
+    /* Channel的事件和poll的事件数值相同 EPOLLIN==POLLIN EPOLLOUT==POLLOUT */
+    sqe->poll32_events = static_cast<uint32_t>(channel->events());
+    sqe->user_data = encodeUserData(channel->fd(), state.generation);
+}
+
+/* 取消fd上还没完成的POLL_ADD */
+void IoUringPoller::disarm(int fd) {
+    PollState& state = stateOf(fd);
+    if (!state.armed) {
+        return;
+    }
+    state.armed = false;
+    io_uring_sqe* sqe = getSqe();
+    sqe->opcode = IORING_OP_POLL_REMOVE;
+    sqe->fd = -1;
+    sqe->addr = encodeUserData(fd, state.generation); /* 要取消的请求 */
+    sqe->user_data = kRemoveUserData;
+}
+
+/* 更新Channel在Poller中的状态 */
+void IoUringPoller::updateChannel(Channel* channel) {
+    int fd = channel->fd();
+    LOG_INFO("func=%s => fd=%d events=%d index=%d \n", __FUNCTION__, fd, channel->events(), channel->index());
+    if (channel->index() == kNew) {
+        addToChannels(fd, channel);
+        channel->set_index(kAdded);
+    }
+    PollState& state = stateOf(fd);
+    if (channel->isNoneEvent()) {
+        /* 没有要关注的事件了 取消请求 */
+        disarm(fd);
+    } else if (!state.armed || state.armedEvents != channel->events()) {
+        /* 关注的事件改变了 取消旧请求 提交新请求 */
+        disarm(fd);
+        arm(channel);
+    }
+}
+
+/* 把Channel从Poller中删除 */
+void IoUringPoller::removeChannel(Channel* channel) {
+    int fd = channel->fd();
+    removeFromChannels(fd);
+    LOG_INFO("func=%s => fd=%d \n", __FUNCTION__, fd);
+    disarm(fd);
+    channel->set_index(kNew);
+}
+
+/* 提交所有请求并等待完成事件 将就绪的Channel通过activeChannels告知EventLoop */
+void IoUringPoller::poll(int timeoutMs, Poller::ChannelList* activeChannels) {
+    LOG_INFO("func=%s => fd total count:%zd\n", __FUNCTION__, numChannels());
+
+    /* 上一轮就绪的Channel 如果仍然关注事件 重新提交POLL_ADD */
+    for (int fd : rearmFds_) {
+        Channel* channel = findChannel(fd);
+        if (channel != nullptr && !channel->isNoneEvent() && !stateOf(fd).armed) {
+            arm(channel);
+        }
+    }
+    rearmFds_.clear();
+
+    /*
+        一次系统调用 提交所有请求并等待
+        有暂存的完成事件时只提交不等待 这些fd的单次poll已经完成 不会再有新的完成事件唤醒loop
+    */
+    int ret = stashedCqes_.empty() ? enter(1, timeoutMs) : enter(0, 0);
+    int saveErrno = errno;
+
+    if (ret < 0 && saveErrno != ETIME && saveErrno != EINTR) {
+        errno = saveErrno;
+        LOG_ERROR("func=%s => io_uring_enter error:%d\n", __FUNCTION__, saveErrno);
+    }
+    reapCompletions(activeChannels);
+}
+
+/* 处理CQ中的完成事件 将就绪的Channel填入activeChannels */
+void IoUringPoller::reapCompletions(Poller::ChannelList* activeChannels) {
+    /* 先处理提交请求时暂存的 它们比CQ中的早 */
+    for (const io_uring_cqe& cqe : stashedCqes_) {
+        handleCompletion(cqe, activeChannels);
+    }
+    stashedCqes_.clear();
+    unsigned head = *cqHead_;
+    unsigned tail = loadAcquire(cqTail_);
+    for (; head != tail; ++ head) {
+        handleCompletion(cqes_[head & *cqMask_], activeChannels);
+    }
+    storeRelease(cqHead_, head);
+    if (!activeChannels->empty()) {
+        LOG_INFO("func=%s => %zd events happened\n", __FUNCTION__, activeChannels->size());
+    }
+}
+
+void IoUringPoller::handleCompletion(const io_uring_cqe& cqe, Poller::ChannelList* activeChannels) {
+    if (cqe.user_data == kRemoveUserData) {
+        return;
+    }
+    int fd = static_cast<int>(cqe.user_data & 0xffffffffu);
+    uint32_t generation = static_cast<uint32_t>(cqe.user_data >> 32);
+    PollState& state = stateOf(fd);
+    if (!state.armed || state.generation != generation) {
+        /* 已经被取消或替换的旧请求 */
+        return;
+    }
+    state.armed = false;
+    Channel* channel = findChannel(fd);
+    if (channel == nullptr || cqe.res == -ECANCELED) {
+        return;
+    }
+    /* res为发生的poll事件 出错时为负的errno 当作EPOLLERR交给Channel处理 */
+    channel->set_revents(cqe.res >= 0 ? cqe.res : static_cast<int>(EPOLLERR));
+    activeChannels->push_back(channel);
+    rearmFds_.push_back(fd);
+}
+
+/* 把CQ中的完成事件取出暂存 版本号在处理时才检查 期间被取消或替换的请求仍然会被忽略 */
+void IoUringPoller::stashCompletions() {
+    unsigned head = *cqHead_;
+    unsigned tail = loadAcquire(cqTail_);
+    for (; head != tail; ++ head) {
+        stashedCqes_.push_back(cqes_[head & *cqMask_]);
+    }
+    storeRelease(cqHead_, head);
+}
@@ -0,0 +1,93 @@
+#ifndef   __IOURINGPOLLER_HH_
+#define   __IOURINGPOLLER_HH_
+
+#include "../Poller.hh"
+
+#include <linux/io_uring.h>
+#include <vector>
+
+class Channel;
+
+/*
+    IoUringPoller 基于io_uring IORING_OP_POLL_ADD的IO复用实现
+    直接使用io_uring_setup/io_uring_enter系统调用 不依赖liburing
+
+    每个Channel对应一个单次(one-shot)的POLL_ADD请求
+        请求完成(fd就绪)后 在下一次poll()时重新提交
+        单次poll提交时会立即检查fd当前的状态 所以和EPollPoller一样是水平触发的语义
+        (多次触发的multishot poll只在fd状态变化时通知 读写没有一次处理完就会丢失事件)
+    关注的事件改变时 用POLL_REMOVE取消旧的请求 再提交新的请求
+    每个请求的user_data中带有fd和版本号 被取消的旧请求的完成事件会被忽略
+
+    一轮循环中所有的提交(重新注册 修改 删除)和等待完成事件 只有一次io_uring_enter
+*/
+class IoUringPoller : public Poller {
+public:
+    /* 构造和析构 */
+    IoUringPoller(EventLoop* loop);
+    ~IoUringPoller() override;
+
+    /* 内核是否支持io_uring 不支持时由newDefaultPoller回退到EPollPoller */
+    bool valid() const { return ringFd_ >= 0; }
+
+    /* io_uring方法接口 */
+    void poll(int timeoutMs, Poller::ChannelList* activeChannels) override;
+    void updateChannel(Channel* channel) override;
+    void removeChannel(Channel* channel) override;
+private:
+    static const unsigned kRingEntries = 1024; /* SQ的大小 CQ是它的两倍 */
+
+    /* 每个fd上POLL_ADD请求的状态 */
+    struct PollState {
+        PollState() : generation(0), armed(false), armedEvents(0) {}
+        uint32_t generation; /* 版本号 每次提交新请求时加一 */
+        bool armed;          /* 是否有还没完成的POLL_ADD请求 */
+        int armedEvents;     /* 该请求关注的事件 */
+    };
+
+    /* 建立io_uring 映射SQ CQ和SQE数组 失败时ringFd_为-1 */
+    bool setupRing();
+    /* 取一个空闲的SQE SQ满时先提交 直到内核取走了请求 */
+    io_uring_sqe* getSqe();
+    /* 提交SQ中的请求 并等待至少minComplete个完成事件 */
+    int enter(unsigned minComplete, int timeoutMs);
+
+    /* 为channel提交POLL_ADD / 取消channel的POLL_ADD */
+    void arm(Channel* channel);
+    void disarm(int fd);
+    PollState& stateOf(int fd);
+
+    /* 处理CQ中的完成事件 将就绪的Channel填入activeChannels */
+    void reapCompletions(Poller::ChannelList* activeChannels);
+    void handleCompletion(const io_uring_cqe& cqe, Poller::ChannelList* activeChannels);
+    /* CQ溢出时内核不接受新的请求 把CQ中的完成事件取出暂存 下一次poll时处理 */
+    void stashCompletions();
+
+    int ringFd_;
+    unsigned sqEntries_;
+
+    /* SQ环的映射 */
+    void* sqRing_;
+    size_t sqRingSize_;
+    unsigned* sqHead_;
+    unsigned* sqTail_;
+    unsigned* sqMask_;
+    unsigned* sqArray_;
+    io_uring_sqe* sqes_;
+    size_t sqesSize_;
+
+    /* CQ环的映射 */
+    void* cqRing_;
+    size_t cqRingSize_;
+    unsigned* cqHead_;
+    unsigned* cqTail_;
+    unsigned* cqMask_;
+    io_uring_cqe* cqes_;
+
+    std::vector<PollState> states_; /* 下标为fd */
+    std::vector<int> rearmFds_;     /* 上一轮就绪的fd 下一次poll()时重新提交 */
+    std::vector<io_uring_cqe> stashedCqes_; /* 提交请求时从CQ中取出的完成事件 */
+};
+
+
+#endif // __IOURINGPOLLER_HH_